@@ -0,0 +1,161 @@
+#ifndef KONDUIT_INSTALLER_EMBEDDED_HPP
+#define KONDUIT_INSTALLER_EMBEDDED_HPP
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include "embed.h"
+
+// typed view of everything generate_embed_files.cmake embedded, built at
+// compile time from KONDUIT_EMBEDDED_FILES so new assets and bundles show up
+// here without touching any code
+
+enum class EmbeddedKind : uint8_t {
+    ASSET,
+    BUNDLE,
+};
+
+/// fnv-1a, stored with every entry so a lookup compares names only once the
+/// hash matched
+constexpr uint32_t embedded_hash(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+/// the sizes are defined next to the #embeds in embed.c and only known there,
+/// so the table points at them instead of holding them
+struct EmbeddedFile {
+    std::string_view name;
+    EmbeddedKind kind;
+    /// what a bundle installs, "core" for BUNDLE_FILE, empty for assets
+    std::string_view component;
+    uint32_t hash;
+    const unsigned char* data;
+    const size_t* size;
+    const char* ext;
+    /// encoding::Codec id, assets are decoded with encoding::decode_embedded
+    const unsigned char* codec;
+    const size_t* uncompressed_size;
+    /// konduit_pack digests of a bundle, null when there are none
+    const unsigned char* digests_data;
+    const size_t* digests_size;
+};
+
+inline constexpr unsigned char EMBEDDED_STORED = 0;
+
+#define KONDUIT_EMBEDDED_ASSET(identifier, file_name)                       \
+    EmbeddedFile{                                                           \
+        file_name,                                                          \
+        EmbeddedKind::ASSET,                                                \
+        {},                                                                 \
+        embedded_hash(file_name),                                           \
+        identifier##_data,                                                  \
+        &identifier##_size,                                                 \
+        identifier##_ext,                                                   \
+        &identifier##_codec,                                                \
+        &identifier##_uncompressed_size,                                    \
+        nullptr,                                                            \
+        nullptr,                                                            \
+    },
+#define KONDUIT_EMBEDDED_BUNDLE(                                            \
+    identifier, file_name, component, digests, digests_size                 \
+)                                                                           \
+    EmbeddedFile{                                                           \
+        file_name,                                                          \
+        EmbeddedKind::BUNDLE,                                               \
+        component,                                                          \
+        embedded_hash(file_name),                                           \
+        identifier##_data,                                                  \
+        &identifier##_size,                                                 \
+        identifier##_ext,                                                   \
+        &EMBEDDED_STORED,                                                   \
+        &identifier##_size,                                                 \
+        digests,                                                            \
+        digests_size,                                                       \
+    },
+
+inline constexpr EmbeddedFile EMBEDDED_FILES[] = {
+    KONDUIT_EMBEDDED_FILES(KONDUIT_EMBEDDED_ASSET, KONDUIT_EMBEDDED_BUNDLE)
+};
+
+#undef KONDUIT_EMBEDDED_ASSET
+#undef KONDUIT_EMBEDDED_BUNDLE
+
+namespace embedded_detail {
+
+constexpr size_t SLOT_BITS =
+    std::bit_width(std::bit_ceil(std::size(EMBEDDED_FILES) * 2) - 1);
+constexpr size_t SLOT_COUNT = size_t{1} << SLOT_BITS;
+
+constexpr size_t slot(uint32_t hash, uint32_t seed) {
+    return static_cast<uint32_t>((hash ^ seed) * 0x9e3779b1u) >>
+           (32 - SLOT_BITS);
+}
+
+/// first seed that sends every name to a slot of its own, the table is at
+/// most half full so this takes a handful of tries
+consteval uint32_t find_seed() {
+    for (uint32_t seed = 0;; ++seed) {
+        std::array<bool, SLOT_COUNT> used{};
+        bool collided = false;
+        for (const auto& file : EMBEDDED_FILES) {
+            auto& taken = used[slot(file.hash, seed)];
+            collided |= taken;
+            taken = true;
+        }
+        if (!collided)
+            return seed;
+    }
+}
+
+constexpr uint32_t SEED = find_seed();
+
+/// index into EMBEDDED_FILES + 1, 0 for an empty slot
+constexpr auto SLOTS = [] {
+    std::array<uint16_t, SLOT_COUNT> slots{};
+    for (size_t i = 0; i < std::size(EMBEDDED_FILES); ++i) {
+        auto index = static_cast<uint16_t>(i + 1);
+        slots[slot(EMBEDDED_FILES[i].hash, SEED)] = index;
+    }
+    return slots;
+}();
+
+}  // namespace embedded_detail
+
+/// a single probe into the perfect hash table, nullptr for names that were
+/// not embedded
+constexpr const EmbeddedFile* embedded_find(std::string_view name) {
+    using namespace embedded_detail;
+    uint32_t hash = embedded_hash(name);
+    uint16_t index = SLOTS[slot(hash, SEED)];
+    if (index == 0)
+        return nullptr;
+    const auto& file = EMBEDDED_FILES[index - 1];
+    return file.hash == hash && file.name == name ? &file : nullptr;
+}
+
+/// resolved while compiling, a name that was not embedded does not build
+consteval const EmbeddedFile& embedded_file(std::string_view name) {
+    const EmbeddedFile* file = embedded_find(name);
+    if (!file)
+        throw "no file of that name is embedded";
+    return *file;
+}
+
+inline std::span<const uint8_t> embedded_bytes(const EmbeddedFile& file) {
+    return {file.data, *file.size};
+}
+
+/// empty when the bundle was embedded without digests
+inline std::span<const uint8_t> embedded_digests(const EmbeddedFile& file) {
+    if (!file.digests_data)
+        return {};
+    return {file.digests_data, *file.digests_size};
+}
+
+#endif  // KONDUIT_INSTALLER_EMBEDDED_HPP
@@ -11,20 +11,72 @@ file(GLOB_RECURSE ASSET_FILES "${ASSETS_DIR}/*")
 set(EMBED_LIST_CURRENT "${CMAKE_CURRENT_BINARY_DIR}/embedded_files")
 set(EMBED_LIST_CACHED "${CMAKE_CURRENT_BINARY_DIR}/embedded_files.cache")
 
-set(BUNDLE_FILE "${_SCRIPT_DIR}/test_assets/GxOGUPjW4AMjYXV.zip" CACHE FILEPATH "Bundle path")
+# passed in by CMakeLists.txt, the defaults only apply when the script is run
+# on its own
+#
+# BUNDLE_FILES, BUNDLE_COMPONENTS and DIGEST_FILES are parallel lists joined
+# with "|", so they survive being passed on the command line
+if (NOT DEFINED BUNDLE_FILES)
+    set(BUNDLE_FILES "${_SCRIPT_DIR}/test_assets/GxOGUPjW4AMjYXV.zip")
+    set(BUNDLE_COMPONENTS "core")
+endif ()
+string(REPLACE "|" ";" BUNDLE_FILES "${BUNDLE_FILES}")
+string(REPLACE "|" ";" BUNDLE_COMPONENTS "${BUNDLE_COMPONENTS}")
+string(REPLACE "|" ";" DIGEST_FILES "${DIGEST_FILES}")
+if (NOT DEFINED ASSET_CODEC)
+    set(ASSET_CODEC "stored")
+endif ()
+
+# compressed assets are written by konduit_compress at build time as
+# <ASSET_OUTPUT_DIR>/<path below assets>.<codec>, the ids match encoding::Codec
+set(_codec_ids stored 0 deflate 1 lz4 2 zstd 3)
+list(FIND _codec_ids "${ASSET_CODEC}" _codec_index)
+if (_codec_index EQUAL -1)
+    message(FATAL_ERROR "Unknown asset codec ${ASSET_CODEC}")
+endif ()
+math(EXPR _codec_index "${_codec_index} + 1")
+list(GET _codec_ids ${_codec_index} ASSET_CODEC_ID)
 
 set(ALL_EMBED_FILES)
+set(ALL_ASSET_FILES)
 foreach (ASSET_FILE ${ASSET_FILES})
     if (NOT IS_DIRECTORY "${ASSET_FILE}")
-        list(APPEND ALL_EMBED_FILES "${ASSET_FILE}")
+        list(APPEND ALL_ASSET_FILES "${ASSET_FILE}")
     endif ()
 endforeach ()
 
-if (BUNDLE_FILE AND EXISTS "${BUNDLE_FILE}" AND NOT IS_DIRECTORY "${BUNDLE_FILE}")
-    list(APPEND ALL_EMBED_FILES "${BUNDLE_FILE}")
+# a generated bundle (konduit pack) is only written at build time, before
+# embed.c is compiled, so it cannot exist yet at configure time
+set(EMBEDDED_BUNDLES)
+set(_bundle_indices)
+list(LENGTH BUNDLE_FILES _bundle_count)
+if (_bundle_count GREATER 0)
+    math(EXPR _last_bundle "${_bundle_count} - 1")
+    foreach (_index RANGE ${_last_bundle})
+        list(APPEND _bundle_indices ${_index})
+    endforeach ()
 endif ()
+foreach (_index ${_bundle_indices})
+    list(GET BUNDLE_FILES ${_index} _bundle)
+    if (BUNDLE_GENERATED OR (EXISTS "${_bundle}" AND NOT IS_DIRECTORY "${_bundle}"))
+        list(APPEND ALL_EMBED_FILES "${_bundle}")
+        list(APPEND EMBEDDED_BUNDLES ${_index})
+        # the digests are written by konduit_pack at build time as well
+        if (DIGEST_FILES)
+            list(GET DIGEST_FILES ${_index} _digests)
+            list(APPEND ALL_EMBED_FILES "${_digests}")
+        endif ()
+    endif ()
+endforeach ()
 
-file(WRITE "${EMBED_LIST_CURRENT}" "")
+# asset sizes, the codec and the components end up in embed.c, so changing
+# them has to regenerate it as well
+file(WRITE "${EMBED_LIST_CURRENT}" "asset codec ${ASSET_CODEC}\n")
+file(APPEND "${EMBED_LIST_CURRENT}" "bundle components ${BUNDLE_COMPONENTS}\n")
+foreach (ASSET_FILE ${ALL_ASSET_FILES})
+    file(SIZE "${ASSET_FILE}" _size)
+    file(APPEND "${EMBED_LIST_CURRENT}" "${ASSET_FILE} ${_size}\n")
+endforeach ()
 foreach (EMBED_FILE ${ALL_EMBED_FILES})
     file(APPEND "${EMBED_LIST_CURRENT}" "${EMBED_FILE}\n")
 endforeach ()
@@ -46,15 +98,27 @@ else ()
     set(SHOULD_REGENERATE_EMBED TRUE)
 endif ()
 
-function(embed_file FILE_PATH)
+function(embed_identifier FILE_PATH OUT_VAR)
     get_filename_component(NAME_WE "${FILE_PATH}" NAME_WE)
     string(REGEX REPLACE "[^a-zA-Z0-9_]" "_" C_IDENTIFIER "${NAME_WE}")
     string(TOLOWER "${C_IDENTIFIER}" C_IDENTIFIER)
+    set(${OUT_VAR} "${C_IDENTIFIER}" PARENT_SCOPE)
+endfunction()
+
+# FILE_PATH names the symbols, the bytes come from DATA_PATH when given
+function(embed_file FILE_PATH)
+    set(DATA_PATH "${FILE_PATH}")
+    if (ARGC GREATER 1)
+        set(DATA_PATH "${ARGV1}")
+    endif ()
+
+    embed_identifier("${FILE_PATH}" C_IDENTIFIER)
 
     get_filename_component(_ext "${FILE_PATH}" EXT)
 
     set(_headers "extern const unsigned char ${C_IDENTIFIER}_data[];\nextern const size_t ${C_IDENTIFIER}_size;\nextern const char ${C_IDENTIFIER}_ext[];\n\n")
-    set(_sources "const unsigned char ${C_IDENTIFIER}_data[] = {\n#embed \"${FILE_PATH}\"\n};\nconst size_t ${C_IDENTIFIER}_size = sizeof(${C_IDENTIFIER}_data);\nconst char ${C_IDENTIFIER}_ext[] = \"${_ext}\";\n\n")
+    # aligned so konduit packs can be read in place straight from the binary
+    set(_sources "alignas(64) const unsigned char ${C_IDENTIFIER}_data[] = {\n#embed \"${DATA_PATH}\"\n};\nconst size_t ${C_IDENTIFIER}_size = sizeof(${C_IDENTIFIER}_data);\nconst char ${C_IDENTIFIER}_ext[] = \"${_ext}\";\n\n")
 
     string(APPEND EMBED_HEADERS "${_headers}")
     string(APPEND EMBED_SOURCES "${_sources}")
@@ -63,16 +127,63 @@ function(embed_file FILE_PATH)
     set(EMBED_SOURCES "${EMBED_SOURCES}" PARENT_SCOPE)
 endfunction()
 
+# ui assets also get <name>_uncompressed_size and <name>_codec, read them
+# through encoding::decode_embedded
+function(embed_asset ASSET_FILE)
+    file(RELATIVE_PATH _relative "${ASSETS_DIR}" "${ASSET_FILE}")
+    set(_data "${ASSET_FILE}")
+    if (NOT ASSET_CODEC STREQUAL "stored")
+        set(_data "${ASSET_OUTPUT_DIR}/${_relative}.${ASSET_CODEC}")
+    endif ()
+    embed_file("${ASSET_FILE}" "${_data}")
+
+    embed_identifier("${ASSET_FILE}" C_IDENTIFIER)
+    file(SIZE "${ASSET_FILE}" _uncompressed_size)
+
+    string(APPEND EMBED_HEADERS "extern const size_t ${C_IDENTIFIER}_uncompressed_size;\nextern const unsigned char ${C_IDENTIFIER}_codec;\n\n")
+    string(APPEND EMBED_SOURCES "const size_t ${C_IDENTIFIER}_uncompressed_size = ${_uncompressed_size};\nconst unsigned char ${C_IDENTIFIER}_codec = ${ASSET_CODEC_ID};\n\n")
+    string(APPEND EMBED_REGISTRY "    ASSET(${C_IDENTIFIER}, \"${_relative}\") \\\n")
+
+    set(EMBED_HEADERS "${EMBED_HEADERS}" PARENT_SCOPE)
+    set(EMBED_SOURCES "${EMBED_SOURCES}" PARENT_SCOPE)
+    set(EMBED_REGISTRY "${EMBED_REGISTRY}" PARENT_SCOPE)
+endfunction()
+
+# bundles are listed by file name and component together with the digests
+# konduit_pack wrote for them, if any
+function(register_bundle INDEX)
+    list(GET BUNDLE_FILES ${INDEX} _bundle)
+    list(GET BUNDLE_COMPONENTS ${INDEX} _component)
+    embed_identifier("${_bundle}" C_IDENTIFIER)
+    get_filename_component(_name "${_bundle}" NAME)
+    set(_digests "nullptr, nullptr")
+    if (DIGEST_FILES)
+        list(GET DIGEST_FILES ${INDEX} _digest_file)
+        embed_identifier("${_digest_file}" _digests_identifier)
+        set(_digests "${_digests_identifier}_data, &${_digests_identifier}_size")
+    endif ()
+    string(APPEND EMBED_REGISTRY "    BUNDLE(${C_IDENTIFIER}, \"${_name}\", \"${_component}\", ${_digests}) \\\n")
+    set(EMBED_REGISTRY "${EMBED_REGISTRY}" PARENT_SCOPE)
+endfunction()
+
 if (SHOULD_REGENERATE_EMBED)
     message(STATUS "Regenerating embed files...")
 
     set(EMBED_HEADERS "")
     set(EMBED_SOURCES "")
+    set(EMBED_REGISTRY "")
 
+    foreach (ASSET_FILE ${ALL_ASSET_FILES})
+        message(STATUS "Embedding asset: ${ASSET_FILE} (${ASSET_CODEC})")
+        embed_asset("${ASSET_FILE}")
+    endforeach ()
     foreach (EMBED_FILE ${ALL_EMBED_FILES})
         message(STATUS "Embedding file: ${EMBED_FILE}")
         embed_file("${EMBED_FILE}")
     endforeach ()
+    foreach (_index ${EMBEDDED_BUNDLES})
+        register_bundle(${_index})
+    endforeach ()
 
     configure_file("${INPUT_HEADER}" "${GENERATED_HEADER}" @ONLY)
     configure_file("${INPUT_SOURCE}" "${GENERATED_SOURCE}" @ONLY)
@@ -0,0 +1,427 @@
+#include "codec.hpp"
+
+#include <lz4/lz4.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined(KONDUIT_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace encoding {
+
+#include <miniz.h>
+
+/// stored payloads are handed out in slices so consumers see steady progress
+constexpr size_t STORED_SLICE_SIZE = 1024 * 1024;
+
+struct DecoderState {
+    tinfl_decompressor inflator;
+    std::vector<uint8_t> window;
+    std::vector<uint8_t> block;
+#if defined(KONDUIT_WITH_ZSTD)
+    ZSTD_DStream* zstd = nullptr;
+    std::vector<uint8_t> zstd_out;
+#endif
+
+    ~DecoderState() {
+#if defined(KONDUIT_WITH_ZSTD)
+        if (zstd)
+            ZSTD_freeDStream(zstd);
+#endif
+    }
+};
+
+Decoder::Decoder() : state(std::make_unique<DecoderState>()) {}
+
+Decoder::~Decoder() = default;
+
+Codec codec_from_zip_method(uint16_t method) {
+    switch (method) {
+        case ZIP_METHOD_STORED:
+            return Codec::STORED;
+        case ZIP_METHOD_DEFLATE:
+            return Codec::DEFLATE;
+        case ZIP_METHOD_ZSTD:
+            return Codec::ZSTD;
+        case ZIP_METHOD_KONDUIT_LZ4:
+            return Codec::LZ4;
+        default:
+            return Codec::UNKNOWN;
+    }
+}
+
+uint16_t zip_method_from_codec(Codec codec) {
+    switch (codec) {
+        case Codec::DEFLATE:
+            return ZIP_METHOD_DEFLATE;
+        case Codec::LZ4:
+            return ZIP_METHOD_KONDUIT_LZ4;
+        case Codec::ZSTD:
+            return ZIP_METHOD_ZSTD;
+        default:
+            return ZIP_METHOD_STORED;
+    }
+}
+
+const char* codec_name(Codec codec) {
+    switch (codec) {
+        case Codec::STORED:
+            return "stored";
+        case Codec::DEFLATE:
+            return "deflate";
+        case Codec::LZ4:
+            return "lz4";
+        case Codec::ZSTD:
+            return "zstd";
+        default:
+            return "unknown";
+    }
+}
+
+bool codec_available(Codec codec) {
+    switch (codec) {
+        case Codec::STORED:
+        case Codec::DEFLATE:
+        case Codec::LZ4:
+            return true;
+        case Codec::ZSTD:
+#if defined(KONDUIT_WITH_ZSTD)
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+static uint32_t read_u32_le(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void write_u32_le(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+static bool
+decode_stored(std::span<const uint8_t> src, const DecodeSink& sink) {
+    for (size_t ofs = 0; ofs < src.size(); ofs += STORED_SLICE_SIZE) {
+        size_t n = std::min(STORED_SLICE_SIZE, src.size() - ofs);
+        if (!sink(src.data() + ofs, n))
+            return false;
+    }
+    return true;
+}
+
+static bool decode_deflate(
+    DecoderState& state,
+    std::span<const uint8_t> src,
+    const DecodeSink& sink
+) {
+    // zip stores raw deflate, the output wraps around a dictionary sized
+    // window the same way miniz's own callback extraction does
+    state.window.resize(TINFL_LZ_DICT_SIZE);
+    tinfl_init(&state.inflator);
+
+    size_t in_ofs = 0;
+    size_t out_ofs = 0;
+    for (;;) {
+        size_t in_size = src.size() - in_ofs;
+        size_t out_size = TINFL_LZ_DICT_SIZE - out_ofs;
+        tinfl_status status = tinfl_decompress(
+            &state.inflator,
+            src.data() + in_ofs,
+            &in_size,
+            state.window.data(),
+            state.window.data() + out_ofs,
+            &out_size,
+            0
+        );
+        in_ofs += in_size;
+
+        if (out_size > 0 && !sink(state.window.data() + out_ofs, out_size))
+            return false;
+        out_ofs = (out_ofs + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (status == TINFL_STATUS_DONE)
+            return true;
+        if (status != TINFL_STATUS_HAS_MORE_OUTPUT)
+            return false;
+    }
+}
+
+template <typename BlockFn>
+static bool for_each_lz4_block(std::span<const uint8_t> src, BlockFn&& fn) {
+    size_t ofs = 0;
+    while (ofs < src.size()) {
+        if (src.size() - ofs < 4)
+            return false;
+        uint32_t header = read_u32_le(src.data() + ofs);
+        ofs += 4;
+        bool raw = (header & LZ4_BLOCK_RAW_FLAG) != 0;
+        size_t size = header & ~LZ4_BLOCK_RAW_FLAG;
+        if (size > src.size() - ofs ||
+            size > LZ4_COMPRESSBOUND(LZ4_BLOCK_SIZE)) {
+            return false;
+        }
+        if (!fn(src.subspan(ofs, size), raw))
+            return false;
+        ofs += size;
+    }
+    return true;
+}
+
+static bool decode_lz4(
+    DecoderState& state,
+    std::span<const uint8_t> src,
+    const DecodeSink& sink
+) {
+    state.block.resize(LZ4_BLOCK_SIZE);
+    return for_each_lz4_block(
+        src,
+        [&](std::span<const uint8_t> block, bool raw) {
+            if (raw)
+                return block.size() <= LZ4_BLOCK_SIZE &&
+                       sink(block.data(), block.size());
+            int n = LZ4_decompress_safe(
+                reinterpret_cast<const char*>(block.data()),
+                reinterpret_cast<char*>(state.block.data()),
+                static_cast<int>(block.size()),
+                static_cast<int>(LZ4_BLOCK_SIZE)
+            );
+            return n >= 0 && sink(state.block.data(), static_cast<size_t>(n));
+        }
+    );
+}
+
+#if defined(KONDUIT_WITH_ZSTD)
+static bool ensure_zstd(DecoderState& state) {
+    if (!state.zstd) {
+        state.zstd = ZSTD_createDStream();
+        if (!state.zstd)
+            return false;
+        state.zstd_out.resize(ZSTD_DStreamOutSize());
+    }
+    return true;
+}
+
+static bool decode_zstd(
+    DecoderState& state,
+    std::span<const uint8_t> src,
+    const DecodeSink& sink
+) {
+    if (!ensure_zstd(state))
+        return false;
+    ZSTD_DCtx_reset(state.zstd, ZSTD_reset_session_only);
+
+    ZSTD_inBuffer in{src.data(), src.size(), 0};
+    size_t last = 1;
+    while (in.pos < in.size) {
+        ZSTD_outBuffer out{state.zstd_out.data(), state.zstd_out.size(), 0};
+        last = ZSTD_decompressStream(state.zstd, &out, &in);
+        if (ZSTD_isError(last))
+            return false;
+        if (out.pos > 0 && !sink(state.zstd_out.data(), out.pos))
+            return false;
+    }
+    // flush whatever the decoder still holds once the input is consumed
+    while (last != 0) {
+        ZSTD_outBuffer out{state.zstd_out.data(), state.zstd_out.size(), 0};
+        last = ZSTD_decompressStream(state.zstd, &out, &in);
+        if (ZSTD_isError(last) || out.pos == 0)
+            return last == 0;
+        if (!sink(state.zstd_out.data(), out.pos))
+            return false;
+    }
+    return true;
+}
+#endif
+
+bool decode_stream(
+    Decoder& decoder,
+    Codec codec,
+    std::span<const uint8_t> src,
+    const DecodeSink& sink
+) {
+    switch (codec) {
+        case Codec::STORED:
+            return decode_stored(src, sink);
+        case Codec::DEFLATE:
+            return decode_deflate(*decoder.state, src, sink);
+        case Codec::LZ4:
+            return decode_lz4(*decoder.state, src, sink);
+#if defined(KONDUIT_WITH_ZSTD)
+        case Codec::ZSTD:
+            return decode_zstd(*decoder.state, src, sink);
+#endif
+        default:
+            return false;
+    }
+}
+
+bool decode_to_memory(
+    [[maybe_unused]] Decoder& decoder,
+    Codec codec,
+    std::span<const uint8_t> src,
+    std::span<uint8_t> dst
+) {
+    switch (codec) {
+        case Codec::STORED:
+            if (src.size() != dst.size())
+                return false;
+            if (!src.empty())
+                std::memcpy(dst.data(), src.data(), src.size());
+            return true;
+        case Codec::DEFLATE: {
+            // the whole output is available, so inflate without the window
+            size_t n = tinfl_decompress_mem_to_mem(
+                dst.data(), dst.size(), src.data(), src.size(), 0
+            );
+            return n == dst.size();
+        }
+        case Codec::LZ4: {
+            size_t written = 0;
+            bool ok = for_each_lz4_block(
+                src,
+                [&](std::span<const uint8_t> block, bool raw) {
+                    size_t room = dst.size() - written;
+                    if (raw) {
+                        if (block.size() > room)
+                            return false;
+                        std::memcpy(
+                            dst.data() + written, block.data(), block.size()
+                        );
+                        written += block.size();
+                        return true;
+                    }
+                    int n = LZ4_decompress_safe(
+                        reinterpret_cast<const char*>(block.data()),
+                        reinterpret_cast<char*>(dst.data() + written),
+                        static_cast<int>(block.size()),
+                        static_cast<int>(std::min(room, LZ4_BLOCK_SIZE))
+                    );
+                    if (n < 0)
+                        return false;
+                    written += static_cast<size_t>(n);
+                    return true;
+                }
+            );
+            return ok && written == dst.size();
+        }
+#if defined(KONDUIT_WITH_ZSTD)
+        case Codec::ZSTD: {
+            auto& state = *decoder.state;
+            if (!ensure_zstd(state))
+                return false;
+            size_t n = ZSTD_decompressDCtx(
+                state.zstd, dst.data(), dst.size(), src.data(), src.size()
+            );
+            return !ZSTD_isError(n) && n == dst.size();
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+static std::optional<std::vector<uint8_t>>
+encode_deflate(std::span<const uint8_t> src, int level) {
+    // negative window bits make tdefl emit raw deflate like zip expects
+    size_t out_len = 0;
+    void* out = tdefl_compress_mem_to_heap(
+        src.data(),
+        src.size(),
+        &out_len,
+        static_cast<int>(tdefl_create_comp_flags_from_zip_params(
+            std::clamp(level, 0, 10), -15, MZ_DEFAULT_STRATEGY
+        ))
+    );
+    if (!out)
+        return std::nullopt;
+    std::vector<uint8_t> result(
+        static_cast<uint8_t*>(out), static_cast<uint8_t*>(out) + out_len
+    );
+    mz_free(out);
+    return result;
+}
+
+static std::optional<std::vector<uint8_t>>
+encode_lz4(std::span<const uint8_t> src) {
+    std::vector<uint8_t> result;
+    std::vector<uint8_t> block(LZ4_COMPRESSBOUND(LZ4_BLOCK_SIZE));
+    for (size_t ofs = 0; ofs < src.size(); ofs += LZ4_BLOCK_SIZE) {
+        size_t n = std::min(LZ4_BLOCK_SIZE, src.size() - ofs);
+        int packed = LZ4_compress_default(
+            reinterpret_cast<const char*>(src.data() + ofs),
+            reinterpret_cast<char*>(block.data()),
+            static_cast<int>(n),
+            static_cast<int>(block.size())
+        );
+        if (packed < 0)
+            return std::nullopt;
+
+        // incompressible blocks are kept raw instead of growing
+        bool raw = packed == 0 || static_cast<size_t>(packed) >= n;
+        const uint8_t* payload = raw ? src.data() + ofs : block.data();
+        size_t payload_size = raw ? n : static_cast<size_t>(packed);
+
+        size_t at = result.size();
+        result.resize(at + 4 + payload_size);
+        write_u32_le(
+            result.data() + at,
+            static_cast<uint32_t>(payload_size) | (raw ? LZ4_BLOCK_RAW_FLAG : 0)
+        );
+        std::memcpy(result.data() + at + 4, payload, payload_size);
+    }
+    return result;
+}
+
+std::optional<std::vector<uint8_t>>
+encode(Codec codec, std::span<const uint8_t> src, int level) {
+    switch (codec) {
+        case Codec::STORED:
+            return std::vector<uint8_t>(src.begin(), src.end());
+        case Codec::DEFLATE:
+            return encode_deflate(src, level);
+        case Codec::LZ4:
+            return encode_lz4(src);
+#if defined(KONDUIT_WITH_ZSTD)
+        case Codec::ZSTD: {
+            std::vector<uint8_t> result(ZSTD_compressBound(src.size()));
+            size_t n = ZSTD_compress(
+                result.data(), result.size(), src.data(), src.size(), level
+            );
+            if (ZSTD_isError(n))
+                return std::nullopt;
+            result.resize(n);
+            return result;
+        }
+#endif
+        default:
+            return std::nullopt;
+    }
+}
+
+std::optional<std::span<const uint8_t>> decode_embedded(
+    std::span<const uint8_t> embedded,
+    size_t uncompressed_size,
+    uint8_t codec,
+    EmbeddedBuffer& buffer
+) {
+    auto which = static_cast<Codec>(codec);
+    if (which == Codec::STORED)
+        return embedded;
+
+    buffer.data.resize(uncompressed_size);
+    if (!decode_to_memory(buffer.decoder, which, embedded, buffer.data))
+        return std::nullopt;
+    return std::span<const uint8_t>(buffer.data);
+}
+
+}  // namespace encoding
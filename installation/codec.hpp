@@ -0,0 +1,104 @@
+#ifndef KONDUIT_INSTALLER_CODEC_HPP
+#define KONDUIT_INSTALLER_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+// kept free of raylib so the bundle builder can share it with the installer
+
+namespace encoding {
+
+enum class Codec : uint8_t {
+    STORED = 0,
+    DEFLATE = 1,
+    LZ4 = 2,
+    ZSTD = 3,
+    UNKNOWN = 0xFF,
+};
+
+/// zip compression method ids, 93 is the registered zstd id, lz4 has none so
+/// konduit bundles use a private one
+constexpr uint16_t ZIP_METHOD_STORED = 0;
+constexpr uint16_t ZIP_METHOD_DEFLATE = 8;
+constexpr uint16_t ZIP_METHOD_ZSTD = 93;
+constexpr uint16_t ZIP_METHOD_KONDUIT_LZ4 = 0x4B34;
+
+/// lz4 payloads are a run of independent blocks, each prefixed with its
+/// little endian u32 compressed size and decoding to at most this many bytes,
+/// a set top bit in the size marks a block stored raw
+///
+/// the vendored lz4 only ships the block api, so this stands in for the lz4
+/// frame format
+constexpr size_t LZ4_BLOCK_SIZE = 256 * 1024;
+constexpr uint32_t LZ4_BLOCK_RAW_FLAG = 0x80000000u;
+
+Codec codec_from_zip_method(uint16_t method);
+uint16_t zip_method_from_codec(Codec codec);
+const char* codec_name(Codec codec);
+
+/// false for zstd when the installer was built without it
+bool codec_available(Codec codec);
+
+/// receives decoded bytes in order, returning false aborts the decode
+using DecodeSink = std::function<bool(const uint8_t* data, size_t size)>;
+
+struct DecoderState;
+
+/// decoding scratch state, one per thread, reused across entries so small
+/// files do not pay for the inflate window and zstd context every time
+struct Decoder {
+    std::unique_ptr<DecoderState> state;
+
+    Decoder();
+    ~Decoder();
+    Decoder(const Decoder&) = delete;
+    Decoder& operator=(const Decoder&) = delete;
+};
+
+/// decodes all of `src` and streams the output through `sink` using a fixed
+/// amount of memory independent of the decoded size
+bool decode_stream(
+    Decoder& decoder,
+    Codec codec,
+    std::span<const uint8_t> src,
+    const DecodeSink& sink
+);
+
+/// decodes `src` into `dst`, which has to be exactly the decoded size
+bool decode_to_memory(
+    Decoder& decoder,
+    Codec codec,
+    std::span<const uint8_t> src,
+    std::span<uint8_t> dst
+);
+
+/// compresses `src` for the bundle builder, level follows the codec's own
+/// scale
+std::optional<std::vector<uint8_t>>
+encode(Codec codec, std::span<const uint8_t> src, int level);
+
+/// scratch kept between decode_embedded calls so decoding several assets
+/// reuses one buffer
+struct EmbeddedBuffer {
+    Decoder decoder;
+    std::vector<uint8_t> data;
+};
+
+/// bytes of an asset generate_embed_files.cmake embedded with `codec`, see
+/// KONDUIT_ASSET_CODEC, stored assets are returned as is and compressed ones
+/// are decoded into `buffer`, valid until its next use
+std::optional<std::span<const uint8_t>> decode_embedded(
+    std::span<const uint8_t> embedded,
+    size_t uncompressed_size,
+    uint8_t codec,
+    EmbeddedBuffer& buffer
+);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_CODEC_HPP
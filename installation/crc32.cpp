@@ -0,0 +1,219 @@
+#include "crc32.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KONDUIT_CRC32_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define KONDUIT_CRC32_ARM 1
+#include <arm_acle.h>
+#include <cstring>
+#if defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#endif
+
+namespace encoding {
+
+#include <miniz.h>
+
+using Crc32Function = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+static uint32_t crc32_table(uint32_t crc, const uint8_t* data, size_t size) {
+    return static_cast<uint32_t>(mz_crc32(crc, data, size));
+}
+
+#if defined(KONDUIT_CRC32_X86)
+
+#if defined(_MSC_VER)
+#define KONDUIT_TARGET_PCLMUL
+#else
+#define KONDUIT_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#endif
+
+// folds 64 bytes at a time with carry-less multiplies and reduces the result
+// with Barrett reduction, after "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction" (Intel, 2009), constants as used by chromium's
+// zlib
+//
+// takes and returns the crc without the pre and post inversion, `size` is at
+// least 64 and a multiple of 16
+KONDUIT_TARGET_PCLMUL static uint32_t
+crc32_fold(uint32_t crc, const uint8_t* buf, size_t size) {
+    alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+    alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+    auto load = [](const uint8_t* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    };
+
+    __m128i x1 = load(buf + 0x00);
+    __m128i x2 = load(buf + 0x10);
+    __m128i x3 = load(buf + 0x20);
+    __m128i x4 = load(buf + 0x30);
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    __m128i x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+    buf += 64;
+    size -= 64;
+
+    // four independent folds keep the multipliers busy
+    while (size >= 64) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), load(buf + 0x00));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), load(buf + 0x10));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), load(buf + 0x20));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), load(buf + 0x30));
+        buf += 64;
+        size -= 64;
+    }
+
+    // fold the four lanes into one
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+    const __m128i lanes[] = {x2, x3, x4};
+    for (__m128i next : lanes) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, next), x5);
+    }
+
+    while (size >= 16) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, load(buf)), x5);
+        buf += 16;
+        size -= 16;
+    }
+
+    // 128 to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t* data, size_t size) {
+    if (size >= 64) {
+        size_t folded = size & ~size_t{15};
+        crc = ~crc32_fold(~crc, data, folded);
+        data += folded;
+        size -= folded;
+    }
+    return crc32_table(crc, data, size);
+}
+
+static bool has_pclmul() {
+    // leaf 1: ecx bit 1 is PCLMULQDQ, bit 19 is SSE4.1
+    constexpr unsigned PCLMUL_BIT = 1u << 1;
+    constexpr unsigned SSE41_BIT = 1u << 19;
+    unsigned ecx = 0;
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    ecx = static_cast<unsigned>(regs[2]);
+#else
+    unsigned eax, ebx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+#endif
+    return (ecx & PCLMUL_BIT) && (ecx & SSE41_BIT);
+}
+
+#elif defined(KONDUIT_CRC32_ARM)
+
+#if defined(_MSC_VER) || defined(__ARM_FEATURE_CRC32)
+#define KONDUIT_TARGET_CRC
+#elif defined(__clang__)
+#define KONDUIT_TARGET_CRC __attribute__((target("crc")))
+#else
+#define KONDUIT_TARGET_CRC __attribute__((target("+crc")))
+#endif
+
+KONDUIT_TARGET_CRC static uint32_t
+crc32_armv8(uint32_t crc, const uint8_t* data, size_t size) {
+    crc = ~crc;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = __crc32d(crc, word);
+        data += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        crc = __crc32b(crc, *data++);
+        size--;
+    }
+    return ~crc;
+}
+
+static bool has_armv8_crc() {
+#if defined(__ARM_FEATURE_CRC32) || defined(__APPLE__) || defined(_MSC_VER)
+    return true;
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return false;
+#endif
+}
+
+#endif
+
+struct Crc32Dispatch {
+    Crc32Function function;
+    const char* name;
+};
+
+static const Crc32Dispatch& crc32_dispatch() {
+    static const Crc32Dispatch dispatch = []() -> Crc32Dispatch {
+#if defined(KONDUIT_CRC32_X86)
+        if (has_pclmul())
+            return {crc32_pclmul, "pclmulqdq"};
+#elif defined(KONDUIT_CRC32_ARM)
+        if (has_armv8_crc())
+            return {crc32_armv8, "armv8 crc32"};
+#endif
+        return {crc32_table, "table"};
+    }();
+    return dispatch;
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size) {
+    if (!data || size == 0)
+        return crc;
+    return crc32_dispatch().function(crc, data, size);
+}
+
+const char* crc32_implementation() {
+    return crc32_dispatch().name;
+}
+
+}  // namespace encoding
@@ -0,0 +1,25 @@
+#ifndef KONDUIT_INSTALLER_CRC32_HPP
+#define KONDUIT_INSTALLER_CRC32_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// kept free of raylib so the bundle builder and the benchmarks can use it
+
+namespace encoding {
+
+constexpr uint32_t CRC32_INIT = 0;
+
+/// zip CRC-32, a drop-in for mz_crc32: start from CRC32_INIT and feed the
+/// previous result back in to continue over more data
+///
+/// uses PCLMULQDQ folding on x86-64 and the ARMv8 CRC32 instructions when
+/// the cpu has them, miniz's table driven version otherwise
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size);
+
+/// name of the implementation crc32_update picked on this cpu
+const char* crc32_implementation();
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_CRC32_HPP
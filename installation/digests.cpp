@@ -0,0 +1,274 @@
+#include "digests.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "mapped_file.hpp"
+
+namespace encoding {
+
+namespace fs = std::filesystem;
+
+constexpr uint8_t LEAF_PREFIX = 0x00;
+constexpr uint8_t ROOT_PREFIX = 0x01;
+
+uint64_t digest_leaf_count(uint64_t size) {
+    return std::max<uint64_t>(
+        1, (size + DIGEST_LEAF_SIZE - 1) / DIGEST_LEAF_SIZE
+    );
+}
+
+Sha256Digest digest_leaf(const uint8_t* data, size_t size) {
+    Sha256 sha;
+    sha256_update(sha, &LEAF_PREFIX, 1);
+    sha256_update(sha, data, size);
+    return sha256_finish(sha);
+}
+
+Sha256Digest digest_root(const Sha256Digest* leaves, size_t count) {
+    Sha256 sha;
+    sha256_update(sha, &ROOT_PREFIX, 1);
+    sha256_update(
+        sha, reinterpret_cast<const uint8_t*>(leaves), count * sizeof(*leaves)
+    );
+    return sha256_finish(sha);
+}
+
+Sha256Digest digest_tree(const uint8_t* data, size_t size) {
+    std::vector<Sha256Digest> leaves(digest_leaf_count(size));
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        size_t offset = i * DIGEST_LEAF_SIZE;
+        leaves[i] = digest_leaf(
+            data + offset, std::min(DIGEST_LEAF_SIZE, size - offset)
+        );
+    }
+    return digest_root(leaves.data(), leaves.size());
+}
+
+std::string digest_to_hex(const Sha256Digest& digest) {
+    std::string hex;
+    hex.reserve(digest.size() * 2);
+    for (auto byte : digest) {
+        hex += std::format("{:02x}", static_cast<unsigned>(byte));
+    }
+    return hex;
+}
+
+std::optional<Sha256Digest> digest_from_hex(std::string_view hex) {
+    Sha256Digest digest;
+    if (hex.size() != digest.size() * 2)
+        return std::nullopt;
+    for (size_t i = 0; i < digest.size(); ++i) {
+        auto parsed = std::from_chars(
+            hex.data() + i * 2, hex.data() + i * 2 + 2, digest[i], 16
+        );
+        if (parsed.ec != std::errc() || parsed.ptr != hex.data() + i * 2 + 2)
+            return std::nullopt;
+    }
+    return digest;
+}
+
+std::string format_digests(const DigestManifest& digests) {
+    std::string text;
+    for (const auto& [name, entry] : digests) {
+        text += std::format(
+            "{} {} {}\n", digest_to_hex(entry.digest), entry.size, name
+        );
+    }
+    return text;
+}
+
+// names are joined onto the install path as is, so anything that could
+// leave it makes the whole manifest invalid
+static bool safe_name(std::string_view name) {
+    fs::path relative = fs::path(name).lexically_normal();
+    if (relative.empty() || relative.is_absolute() ||
+        relative.has_root_name() || relative.has_root_directory()) {
+        return false;
+    }
+    return std::ranges::none_of(relative, [](const fs::path& part) {
+        return part == "..";
+    });
+}
+
+std::optional<DigestManifest> parse_digests(std::string_view text) {
+    DigestManifest digests;
+    while (!text.empty()) {
+        auto end = text.find('\n');
+        auto line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view{}
+                                             : text.substr(end + 1);
+        if (line.empty())
+            continue;
+
+        auto digest_end = line.find(' ');
+        if (digest_end == std::string_view::npos)
+            return std::nullopt;
+        auto size_end = line.find(' ', digest_end + 1);
+        if (size_end == std::string_view::npos || size_end + 1 >= line.size())
+            return std::nullopt;
+
+        DigestEntry entry{};
+        auto digest = digest_from_hex(line.substr(0, digest_end));
+        auto size = std::from_chars(
+            line.data() + digest_end + 1, line.data() + size_end, entry.size
+        );
+        auto name = line.substr(size_end + 1);
+        if (!digest || size.ec != std::errc() || !safe_name(name))
+            return std::nullopt;
+        entry.digest = *digest;
+        digests.insert_or_assign(std::string(name), entry);
+    }
+    return digests;
+}
+
+namespace {
+
+struct VerifyFile {
+    const std::string* name;
+    const DigestEntry* expected;
+    uint64_t leaf_count;
+    std::vector<Sha256Digest> leaves;
+    /// mapped by whichever thread reaches the file first, unmapped by the one
+    /// finishing its last leaf
+    std::once_flag opened;
+    std::unique_ptr<MappedFile> mapped;
+    bool unreadable = false;
+    std::atomic<uint64_t> remaining;
+};
+
+struct VerifyLeaf {
+    uint32_t file;
+    uint32_t leaf;
+};
+
+}  // namespace
+
+static void open_for_verify(VerifyFile& file, const fs::path& install_path) {
+    auto path = install_path / *file.name;
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    if (ec || size != file.expected->size || !fs::is_regular_file(path, ec)) {
+        file.unreadable = true;
+        return;
+    }
+    if (size == 0)
+        return;
+    file.mapped = map_file(path);
+    file.unreadable = !file.mapped || file.mapped->size != size;
+}
+
+VerifyResult verify_digests(
+    const fs::path& install_path,
+    const DigestManifest& digests,
+    const VerifyOptions& options
+) {
+    using Clock = std::chrono::steady_clock;
+    auto started = Clock::now();
+    VerifyResult result;
+
+    std::vector<VerifyFile> files(digests.size());
+    size_t count = 0;
+    for (const auto& [name, entry] : digests) {
+        if (options.skip && options.skip(name))
+            continue;
+        auto& file = files[count++];
+        file.name = &name;
+        file.expected = &entry;
+        file.leaf_count = digest_leaf_count(entry.size);
+        file.leaves.resize(file.leaf_count);
+        file.remaining = file.leaf_count;
+    }
+
+    std::vector<uint32_t> order(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        order[i] = i;
+    }
+    std::ranges::stable_sort(order, [&](uint32_t a, uint32_t b) {
+        return files[a].expected->size > files[b].expected->size;
+    });
+    std::vector<VerifyLeaf> work;
+    for (auto i : order) {
+        for (uint64_t leaf = 0; leaf < files[i].leaf_count; ++leaf) {
+            work.push_back({i, static_cast<uint32_t>(leaf)});
+        }
+    }
+
+    uint32_t threads = options.threads;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<uint32_t>(
+        std::clamp<size_t>(threads, 1, std::max<size_t>(work.size(), 1))
+    );
+    result.threads = threads;
+
+    std::atomic<size_t> next{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<bool> cancelled{false};
+    std::mutex failed_mutex;
+
+    auto worker = [&] {
+        for (;;) {
+            if (options.cancelled && *options.cancelled) {
+                cancelled = true;
+                return;
+            }
+            size_t index = next.fetch_add(1, std::memory_order_relaxed);
+            if (index >= work.size())
+                return;
+
+            auto [f, leaf] = work[index];
+            auto& file = files[f];
+            std::call_once(file.opened, open_for_verify, file, install_path);
+
+            if (!file.unreadable) {
+                uint64_t offset = uint64_t{leaf} * DIGEST_LEAF_SIZE;
+                size_t size = static_cast<size_t>(std::min<uint64_t>(
+                    DIGEST_LEAF_SIZE, file.expected->size - offset
+                ));
+                const uint8_t* data =
+                    file.mapped ? file.mapped->data + offset : nullptr;
+                file.leaves[leaf] = digest_leaf(data, size);
+                bytes += size;
+                if (options.bytes_done)
+                    *options.bytes_done += size;
+            }
+
+            // the last leaf sees every other leaf's digest through the
+            // acq_rel countdown
+            if (file.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                continue;
+            bool ok = !file.unreadable &&
+                      digest_root(file.leaves.data(), file.leaves.size()) ==
+                          file.expected->digest;
+            file.mapped.reset();
+            file.leaves = {};
+            if (!ok) {
+                std::lock_guard lock(failed_mutex);
+                result.failed.push_back(*file.name);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (uint32_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    std::ranges::sort(result.failed);
+    result.bytes = bytes;
+    result.cancelled = cancelled;
+    result.seconds =
+        std::chrono::duration<double>(Clock::now() - started).count();
+    return result;
+}
+
+}  // namespace encoding
@@ -0,0 +1,82 @@
+#ifndef KONDUIT_INSTALLER_DIGESTS_HPP
+#define KONDUIT_INSTALLER_DIGESTS_HPP
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "sha256.hpp"
+
+// kept free of raylib so the bundle builder can share it with the installer
+
+namespace encoding {
+
+/// files are hashed as a two level tree so one large file can be verified by
+/// many threads: every leaf of DIGEST_LEAF_SIZE bytes is hashed on its own as
+/// sha256(0x00 || leaf) and the file digest is sha256(0x01 || leaf digests),
+/// an empty file is a single empty leaf
+constexpr size_t DIGEST_LEAF_SIZE = 1024 * 1024;
+
+uint64_t digest_leaf_count(uint64_t size);
+Sha256Digest digest_leaf(const uint8_t* data, size_t size);
+Sha256Digest digest_root(const Sha256Digest* leaves, size_t count);
+
+/// tree digest of a whole buffer on the calling thread
+Sha256Digest digest_tree(const uint8_t* data, size_t size);
+
+std::string digest_to_hex(const Sha256Digest& digest);
+std::optional<Sha256Digest> digest_from_hex(std::string_view hex);
+
+struct DigestEntry {
+    uint64_t size;
+    Sha256Digest digest;
+};
+
+/// expected tree digests of the shipped files by archive entry name, built
+/// with the bundle and embedded next to it
+using DigestManifest = std::map<std::string, DigestEntry, std::less<>>;
+
+/// one line per file: "<digest hex> <size> <name>", the name runs to the end
+/// of the line so it may contain spaces
+std::string format_digests(const DigestManifest& digests);
+
+/// nullopt on any malformed line
+std::optional<DigestManifest> parse_digests(std::string_view text);
+
+struct VerifyOptions {
+    /// 0 uses every hardware thread
+    uint32_t threads = 0;
+    /// names that are known to be bad already and are not read again
+    std::function<bool(std::string_view name)> skip;
+    /// optional, polled between leaves
+    const std::atomic<bool>* cancelled = nullptr;
+    /// optional, advanced by the bytes hashed
+    std::atomic<uint64_t>* bytes_done = nullptr;
+};
+
+struct VerifyResult {
+    /// missing files, files of the wrong size and digest mismatches
+    std::vector<std::string> failed;
+    uint64_t bytes = 0;
+    uint32_t threads = 0;
+    double seconds = 0;
+    bool cancelled = false;
+};
+
+/// checks every file of `digests` under `install_path`, the leaves of all
+/// files are shared out between the threads, largest file first, so a single
+/// huge file keeps every core busy and files are mapped only while their
+/// leaves are hashed
+VerifyResult verify_digests(
+    const std::filesystem::path& install_path,
+    const DigestManifest& digests,
+    const VerifyOptions& options = {}
+);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_DIGESTS_HPP
@@ -1,8 +1,17 @@
 #include "encoding_handling.hpp"
 
+#include <algorithm>
+#include <tuple>
+
 namespace encoding {
 
-ZipReader::ZipReader() : owns_buffer(false), current_index(0), total_files(0) {
+ZipReader::ZipReader()
+    : format(BundleFormat::ZIP),
+      memory(nullptr),
+      memory_size(0),
+      owns_buffer(false),
+      current_index(0),
+      total_files(0) {
     mz_zip_zero_struct(&archive);
 }
 
@@ -30,6 +39,96 @@ std::optional<ZipFileInfo> ZipIterator::operator*() const {
     return zip_get_file_info(reader, index);
 }
 
+static bool build_index(ZipReader* reader) {
+    auto& index = reader->index;
+    uint32_t count = reader->total_files;
+
+    index.name_offsets.reserve(count + 1);
+    index.name_hashes.reserve(count);
+    index.uncompressed_sizes.reserve(count);
+    index.compressed_sizes.reserve(count);
+    index.local_header_offsets.reserve(count);
+    index.crc32s.reserve(count);
+    index.methods.reserve(count);
+    index.directories.reserve(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        mz_zip_archive_file_stat file_stat;
+        if (!mz_zip_reader_file_stat(&reader->archive, i, &file_stat)) {
+            return false;
+        }
+        std::string_view name = file_stat.m_filename;
+        index.name_offsets.push_back(
+            static_cast<uint32_t>(index.names.size())
+        );
+        index.names.append(name);
+        index.name_hashes.push_back(pack_hash(name));
+        index.uncompressed_sizes.push_back(file_stat.m_uncomp_size);
+        index.compressed_sizes.push_back(file_stat.m_comp_size);
+        index.local_header_offsets.push_back(file_stat.m_local_header_ofs);
+        index.crc32s.push_back(file_stat.m_crc32);
+        index.methods.push_back(file_stat.m_method);
+        index.directories.push_back(file_stat.m_is_directory ? 1 : 0);
+    }
+    index.name_offsets.push_back(static_cast<uint32_t>(index.names.size()));
+
+    // load factor stays at or below 0.5 so probe sequences remain short
+    size_t capacity = 16;
+    while (capacity < static_cast<size_t>(count) * 2) {
+        capacity <<= 1;
+    }
+    index.slots.assign(capacity, 0);
+    size_t mask = capacity - 1;
+    for (uint32_t i = 0; i < count; ++i) {
+        size_t slot = index.name_hashes[i] & mask;
+        while (index.slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        index.slots[slot] = i + 1;
+    }
+    return true;
+}
+
+static bool
+pack_open_memory(ZipReader* reader, const uint8_t* data, size_t size) {
+    // the table of contents is read in place, which needs the natural
+    // alignment of its fields, callers handing in an unaligned buffer pay for
+    // one copy
+    if (reinterpret_cast<uintptr_t>(data) % alignof(PackEntry) != 0) {
+        reader->file_buffer.assign(data, data + size);
+        data = reader->file_buffer.data();
+    }
+    reader->pack = pack_open_view(data, size);
+    if (!reader->pack) {
+        error("Invalid konduit pack header");
+        return false;
+    }
+    reader->format = BundleFormat::KPACK;
+    reader->total_files = reader->pack->header->entry_count;
+    reader->memory = data;
+    reader->memory_size = size;
+    return true;
+}
+
+static bool
+zip_open_memory(ZipReader* reader, const uint8_t* data, size_t size) {
+    if (is_pack(data, size)) {
+        return pack_open_memory(reader, data, size);
+    }
+
+    if (!mz_zip_reader_init_mem(&reader->archive, data, size, 0)) {
+        return false;
+    }
+    reader->total_files = mz_zip_reader_get_num_files(&reader->archive);
+    reader->memory = data;
+    reader->memory_size = size;
+    if (!build_index(reader)) {
+        error("Failed to index the ZIP central directory");
+        return false;
+    }
+    return true;
+}
+
 std::unique_ptr<ZipReader>
 zip_init_from_buffer(const unsigned char* buffer, size_t size) {
     if (!buffer || size == 0) {
@@ -38,16 +137,29 @@ zip_init_from_buffer(const unsigned char* buffer, size_t size) {
     }
 
     auto reader = std::make_unique<ZipReader>();
-    if (!mz_zip_reader_init_mem(&reader->archive, buffer, size, 0)) {
+    if (!zip_open_memory(reader.get(), buffer, size)) {
         return nullptr;
     }
-    reader->total_files = mz_zip_reader_get_num_files(&reader->archive);
     reader->owns_buffer = false;
     return reader;
 }
 
 std::unique_ptr<ZipReader> zip_init_from_file(std::string_view filepath) {
-    std::ifstream file(filepath.data(), std::ios::binary | std::ios::ate);
+    // mapping only costs page table setup, entries are paged in once they
+    // are actually extracted
+    if (auto mapping = map_file(std::filesystem::path(filepath))) {
+        auto reader = std::make_unique<ZipReader>();
+        if (!zip_open_memory(reader.get(), mapping->data, mapping->size)) {
+            return nullptr;
+        }
+        reader->mapping = std::move(mapping);
+        reader->owns_buffer = true;
+        return reader;
+    }
+
+    std::ifstream file(
+        std::filesystem::path(filepath), std::ios::binary | std::ios::ate
+    );
     if (!file) {
         return nullptr;
     }
@@ -59,23 +171,56 @@ std::unique_ptr<ZipReader> zip_init_from_file(std::string_view filepath) {
     if (!file.read(reinterpret_cast<char*>(reader->file_buffer.data()), size)) {
         return nullptr;
     }
-    if (!mz_zip_reader_init_mem(
-            &reader->archive,
+    if (!zip_open_memory(
+            reader.get(),
             reader->file_buffer.data(),
-            reader->file_buffer.size(),
-            0
+            reader->file_buffer.size()
         )) {
         return nullptr;
     }
-    reader->total_files = mz_zip_reader_get_num_files(&reader->archive);
     reader->owns_buffer = true;
     return reader;
 }
 
+static ZipFileInfo pack_file_info(const ZipReader* reader, uint32_t index) {
+    const auto& entry = reader->pack->entries[index];
+    auto name = pack_entry_name(*reader->pack, entry);
+
+    ZipFileInfo info;
+    info.filename = name;
+    info.uncompressed_size = entry.uncompressed_size;
+    info.compressed_size = entry.compressed_size;
+    info.crc32 = entry.crc32;
+    info.is_directory = (entry.flags & PACK_ENTRY_DIRECTORY) != 0;
+    info.codec = static_cast<Codec>(entry.codec);
+    info.method = zip_method_from_codec(info.codec);
+
+    // packs have no miniz stat, fill in what maps onto one
+    info.mz_stat = {};
+    info.mz_stat.m_file_index = index;
+    info.mz_stat.m_method = info.method;
+    info.mz_stat.m_time = static_cast<MZ_TIME_T>(entry.mtime);
+    info.mz_stat.m_crc32 = entry.crc32;
+    info.mz_stat.m_comp_size = entry.compressed_size;
+    info.mz_stat.m_uncomp_size = entry.uncompressed_size;
+    // pack modes are unix ones, as if the entry was zipped on unix
+    info.mz_stat.m_version_made_by = 3 << 8;
+    info.mz_stat.m_external_attr = entry.mode << 16;
+    info.mz_stat.m_is_directory = info.is_directory;
+    info.mz_stat.m_is_supported = codec_available(info.codec);
+    name.copy(
+        info.mz_stat.m_filename,
+        std::min(name.size(), sizeof(info.mz_stat.m_filename) - 1)
+    );
+    return info;
+}
+
 std::optional<ZipFileInfo>
 zip_get_file_info(ZipReader* reader, uint32_t index) {
     if (!reader || index >= reader->total_files)
         return nullopt;
+    if (reader->format == BundleFormat::KPACK)
+        return pack_file_info(reader, index);
     mz_zip_archive_file_stat file_stat;
     if (!mz_zip_reader_file_stat(&reader->archive, index, &file_stat)) {
         return nullopt;
@@ -88,10 +233,87 @@ zip_get_file_info(ZipReader* reader, uint32_t index) {
     info.is_directory =
         mz_zip_reader_is_file_a_directory(&reader->archive, index);
     info.method = file_stat.m_method;
+    info.codec = codec_from_zip_method(file_stat.m_method);
     info.mz_stat = file_stat;
     return info;
 }
 
+std::optional<ZipEntry> zip_get_entry(const ZipReader* reader, uint32_t index) {
+    if (!reader || index >= reader->total_files)
+        return nullopt;
+    if (reader->format == BundleFormat::KPACK) {
+        const auto& entry = reader->pack->entries[index];
+        auto codec = static_cast<Codec>(entry.codec);
+        bool solid = (entry.flags & PACK_ENTRY_SOLID) != 0;
+        return ZipEntry{
+            .name = pack_entry_name(*reader->pack, entry),
+            .uncompressed_size = entry.uncompressed_size,
+            .compressed_size = entry.compressed_size,
+            .local_header_offset = entry.data_offset,
+            .crc32 = entry.crc32,
+            .index = index,
+            .chunk = solid ? entry.chunk : NO_CHUNK,
+            .method = zip_method_from_codec(codec),
+            .codec = codec,
+            .is_directory = (entry.flags & PACK_ENTRY_DIRECTORY) != 0,
+        };
+    }
+    const auto& idx = reader->index;
+    uint32_t name_begin = idx.name_offsets[index];
+    uint32_t name_end = idx.name_offsets[index + 1];
+    return ZipEntry{
+        .name = std::string_view(idx.names)
+                    .substr(name_begin, name_end - name_begin),
+        .uncompressed_size = idx.uncompressed_sizes[index],
+        .compressed_size = idx.compressed_sizes[index],
+        .local_header_offset = idx.local_header_offsets[index],
+        .crc32 = idx.crc32s[index],
+        .index = index,
+        .chunk = NO_CHUNK,
+        .method = idx.methods[index],
+        .codec = codec_from_zip_method(idx.methods[index]),
+        .is_directory = idx.directories[index] != 0,
+    };
+}
+
+BlobKey zip_blob_key(const ZipEntry& entry) {
+    // size and crc tell apart empty files that share an offset with the next
+    // payload
+    return {
+        entry.chunk,
+        entry.local_header_offset,
+        entry.uncompressed_size,
+        entry.crc32
+    };
+}
+
+std::optional<ZipEntry>
+zip_find_entry(const ZipReader* reader, std::string_view filename) {
+    if (reader && reader->format == BundleFormat::KPACK) {
+        auto index = pack_find(*reader->pack, filename);
+        if (!index)
+            return nullopt;
+        return zip_get_entry(reader, *index);
+    }
+    if (!reader || reader->index.slots.empty())
+        return nullopt;
+    const auto& idx = reader->index;
+    uint64_t hash = pack_hash(filename);
+    size_t mask = idx.slots.size() - 1;
+    for (size_t slot = hash & mask; idx.slots[slot] != 0;
+         slot = (slot + 1) & mask) {
+        uint32_t i = idx.slots[slot] - 1;
+        if (idx.name_hashes[i] != hash)
+            continue;
+        std::string_view name = std::string_view(idx.names).substr(
+            idx.name_offsets[i], idx.name_offsets[i + 1] - idx.name_offsets[i]
+        );
+        if (name == filename)
+            return zip_get_entry(reader, i);
+    }
+    return nullopt;
+}
+
 std::optional<ZipFileInfo> zip_current_file_info(ZipReader* reader) {
     return zip_get_file_info(reader, reader->current_index);
 }
@@ -119,64 +341,276 @@ uint32_t zip_get_file_count(ZipReader* reader) {
 std::optional<std::vector<uint8_t>> zip_extract_current_file(
     ZipReader* reader
 ) {
-    if (!reader || reader->current_index >= reader->total_files)
+    if (!reader)
         return std::nullopt;
-    size_t uncomp_size;
-    void* data = mz_zip_reader_extract_to_heap(
-        &reader->archive, reader->current_index, &uncomp_size, 0
+    return zip_extract_file_by_index(reader, reader->current_index);
+}
+
+static uint16_t read_u16_le(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_u32_le(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+std::optional<std::span<const uint8_t>>
+zip_entry_data(const ZipReader* reader, const ZipEntry& entry) {
+    constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+    constexpr uint64_t LOCAL_HEADER_SIZE = 30;
+
+    if (!reader || !reader->memory || entry.chunk != NO_CHUNK)
+        return nullopt;
+    uint64_t size = reader->memory_size;
+
+    if (reader->format == BundleFormat::KPACK) {
+        // pack entries point straight at their payload
+        uint64_t data = entry.local_header_offset;
+        if (data > size || size - data < entry.compressed_size)
+            return nullopt;
+        return std::span<const uint8_t>(
+            reader->memory + data, static_cast<size_t>(entry.compressed_size)
+        );
+    }
+
+    uint64_t header = entry.local_header_offset;
+    if (header > size || size - header < LOCAL_HEADER_SIZE)
+        return nullopt;
+
+    const uint8_t* h = reader->memory + header;
+    if (read_u32_le(h) != LOCAL_HEADER_SIGNATURE)
+        return nullopt;
+
+    // the local name and extra field lengths can differ from the central
+    // directory ones, so the data offset has to come from the local header
+    uint64_t data = header + LOCAL_HEADER_SIZE + read_u16_le(h + 26) +
+                    read_u16_le(h + 28);
+    if (data > size || size - data < entry.compressed_size)
+        return nullopt;
+    return std::span<const uint8_t>(
+        reader->memory + data, static_cast<size_t>(entry.compressed_size)
+    );
+}
+
+static bool codec_usable(const ZipEntry& entry) {
+    if (codec_available(entry.codec))
+        return true;
+    error(
+        std::format(
+            "{} uses unsupported compression method {} ({})",
+            entry.name,
+            entry.method,
+            codec_name(entry.codec)
+        )
+            .c_str()
+    );
+    return false;
+}
+
+static bool verify_entry(const ZipEntry& entry, uint64_t size, uint32_t crc) {
+    if (size == entry.uncompressed_size && crc == entry.crc32)
+        return true;
+    error(
+        std::format(
+            "{} is corrupt: got {} bytes with crc {:08x}, expected {} bytes "
+            "with crc {:08x}",
+            entry.name,
+            size,
+            crc,
+            entry.uncompressed_size,
+            entry.crc32
+        )
+            .c_str()
+    );
+    return false;
+}
+
+uint32_t zip_get_chunk_count(const ZipReader* reader) {
+    if (!reader || reader->format != BundleFormat::KPACK)
+        return 0;
+    return reader->pack->header->chunk_count;
+}
+
+bool zip_load_chunk(
+    const ZipReader* reader,
+    uint32_t chunk,
+    Decoder& decoder,
+    ChunkCache& cache
+) {
+    if (cache.chunk == chunk)
+        return true;
+    if (chunk >= zip_get_chunk_count(reader))
+        return false;
+
+    const auto& info = reader->pack->chunks[chunk];
+    auto codec = static_cast<Codec>(info.codec);
+    uint64_t size = reader->memory_size;
+    if (info.data_offset > size ||
+        size - info.data_offset < info.compressed_size) {
+        error(std::format("Solid chunk {} is out of bounds", chunk).c_str());
+        return false;
+    }
+    if (!codec_available(codec)) {
+        error(
+            std::format(
+                "Solid chunk {} uses unsupported codec {}",
+                chunk,
+                codec_name(codec)
+            )
+                .c_str()
+        );
+        return false;
+    }
+
+    // invalidate first so a failed decode never leaves a half written chunk
+    // behind under a valid index
+    cache.chunk = NO_CHUNK;
+    cache.data.resize(info.uncompressed_size);
+    std::span<const uint8_t> src(
+        reader->memory + info.data_offset,
+        static_cast<size_t>(info.compressed_size)
     );
+    if (!decode_to_memory(decoder, codec, src, cache.data)) {
+        error(std::format("Failed to decode solid chunk {}", chunk).c_str());
+        return false;
+    }
+    cache.chunk = chunk;
+    return true;
+}
+
+/// the entry's bytes inside its decoded chunk
+static std::optional<std::span<const uint8_t>> solid_entry_data(
+    const ZipReader* reader,
+    const ZipEntry& entry,
+    Decoder& decoder,
+    ChunkCache& cache
+) {
+    if (!zip_load_chunk(reader, entry.chunk, decoder, cache))
+        return nullopt;
+    uint64_t offset = entry.local_header_offset;
+    if (offset > cache.data.size() ||
+        cache.data.size() - offset < entry.uncompressed_size) {
+        return nullopt;
+    }
+    return std::span<const uint8_t>(
+        cache.data.data() + offset,
+        static_cast<size_t>(entry.uncompressed_size)
+    );
+}
+
+bool zip_decode_entry(
+    const ZipReader* reader,
+    const ZipEntry& entry,
+    Decoder& decoder,
+    const DecodeSink& sink,
+    ChunkCache* cache
+) {
+    if (entry.chunk != NO_CHUNK) {
+        ChunkCache local;
+        auto data =
+            solid_entry_data(reader, entry, decoder, cache ? *cache : local);
+        if (!data)
+            return false;
+        auto crc = crc32_update(CRC32_INIT, data->data(), data->size());
+        return verify_entry(entry, data->size(), crc) &&
+               sink(data->data(), data->size());
+    }
+
+    if (!codec_usable(entry))
+        return false;
+    auto data = zip_entry_data(reader, entry);
     if (!data)
-        return std::nullopt;
-    std::vector<uint8_t> result(
-        static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + uncomp_size
+        return false;
+
+    // verified inline as blocks leave the decoder, so the data is only read
+    // once while it is still in cache
+    uint32_t crc = CRC32_INIT;
+    uint64_t size = 0;
+    bool ok = decode_stream(
+        decoder,
+        entry.codec,
+        *data,
+        [&](const uint8_t* chunk, size_t n) {
+            crc = crc32_update(crc, chunk, n);
+            size += n;
+            return sink(chunk, n);
+        }
     );
-    mz_free(data);
-    return result;
+    return ok && verify_entry(entry, size, crc);
+}
+
+bool zip_extract_file_into(
+    ZipReader* reader,
+    uint32_t index,
+    std::span<uint8_t> dst,
+    Decoder& decoder
+) {
+    auto entry = zip_get_entry(reader, index);
+    if (!entry || dst.size() != entry->uncompressed_size)
+        return false;
+
+    if (entry->chunk != NO_CHUNK) {
+        // consecutive entries of a chunk hit the reader's cache and only pay
+        // for the copy
+        auto data =
+            solid_entry_data(reader, *entry, decoder, reader->chunk_cache);
+        if (!data)
+            return false;
+        std::copy(data->begin(), data->end(), dst.begin());
+    } else {
+        if (!codec_usable(*entry))
+            return false;
+        auto data = zip_entry_data(reader, *entry);
+        // decode straight into the destination instead of going through a
+        // heap block that would have to be copied again
+        if (!data || !decode_to_memory(decoder, entry->codec, *data, dst))
+            return false;
+    }
+
+    auto crc = crc32_update(CRC32_INIT, dst.data(), dst.size());
+    return verify_entry(*entry, dst.size(), crc);
+}
+
+std::optional<std::span<const uint8_t>>
+zip_stored_entry_view(const ZipReader* reader, uint32_t index) {
+    auto entry = zip_get_entry(reader, index);
+    if (!entry || entry->is_directory || entry->chunk != NO_CHUNK ||
+        entry->codec != Codec::STORED ||
+        entry->compressed_size != entry->uncompressed_size) {
+        return nullopt;
+    }
+    return zip_entry_data(reader, *entry);
 }
 
 std::optional<std::vector<uint8_t>>
 zip_extract_file_by_index(ZipReader* reader, uint32_t index) {
-    if (!reader || index >= reader->total_files)
+    auto entry = zip_get_entry(reader, index);
+    if (!entry)
         return std::nullopt;
-    size_t uncomp_size;
-    void* data =
-        mz_zip_reader_extract_to_heap(&reader->archive, index, &uncomp_size, 0);
-    if (!data)
+
+    Decoder decoder;
+    std::vector<uint8_t> result(entry->uncompressed_size);
+    if (!zip_extract_file_into(reader, index, result, decoder))
         return std::nullopt;
-    std::vector<uint8_t> result(
-        static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + uncomp_size
-    );
-    mz_free(data);
     return result;
 }
 
 std::optional<std::vector<uint8_t>>
 zip_extract_file_by_name(ZipReader* reader, std::string_view filename) {
-    if (!reader)
-        return std::nullopt;
-    size_t uncomp_size;
-    void* data = mz_zip_reader_extract_file_to_heap(
-        &reader->archive, filename.data(), &uncomp_size, 0
-    );
-    if (!data)
+    auto index = zip_find_file_index(reader, filename);
+    if (!index)
         return std::nullopt;
-    std::vector<uint8_t> result(
-        static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + uncomp_size
-    );
-    mz_free(data);
-    return result;
+    return zip_extract_file_by_index(reader, *index);
 }
 
 std::optional<uint32_t>
 zip_find_file_index(ZipReader* reader, std::string_view filename) {
-    if (!reader)
-        return nullopt;
-    int idx = mz_zip_reader_locate_file(
-        &reader->archive, filename.data(), nullptr, 0
-    );
-    if (idx < 0)
+    auto entry = zip_find_entry(reader, filename);
+    if (!entry)
         return nullopt;
-    return static_cast<uint32_t>(idx);
+    return entry->index;
 }
 
 ZipIterator begin(ZipReader* reader) {
@@ -187,166 +621,176 @@ ZipIterator end(ZipReader* reader) {
     return {reader, reader ? reader->total_files : 0};
 }
 
-std::optional<LoadedData>
-load_resource_from_memory(const unsigned char* buffer, size_t buffer_size) {
-    auto reader = zip_init_from_buffer(buffer, buffer_size);
-    if (!reader) {
-        error("Failed to initialize ZIP archive from memory");
-        return std::nullopt;
-    }
-
-    LoadedData result;
-    ZipReader* zip = reader.get();
-
-    for (uint32_t i = 0; i < zip_get_file_count(zip); ++i) {
-        auto info_opt = zip_get_file_info(zip, i);
-        if (!info_opt)
-            continue;
+std::span<const uint8_t>
+loaded_file_data(const LoadedData& loaded, const LoadedFile& file) {
+    const uint8_t* base =
+        file.in_archive ? loaded.reader->memory : loaded.arena.data();
+    return {base + file.data_offset, static_cast<size_t>(file.size)};
+}
 
-        const auto& info = *info_opt;
-        info(
-            std::format(
-                "File entry: {} | Compressed Size: {} | Uncompressed Size: {}",
-                info.filename,
-                info.compressed_size,
-                info.uncompressed_size
-            )
-                .c_str()
-        );
+std::string_view
+loaded_file_name(const LoadedData& loaded, const LoadedFile& file) {
+    return {loaded.names.data() + file.name_offset, file.name_size};
+}
 
-        if (info.uncompressed_size > 0 && !info.is_directory) {
-            auto data_opt = zip_extract_file_by_index(zip, i);
-            if (!data_opt || data_opt->empty()) {
-                error(
-                    std::format("Failed to extract data for {}", info.filename)
-                        .c_str()
-                );
-                continue;
-            }
-
-            result.data[info.filename] = std::move(*data_opt);
+std::optional<std::span<const uint8_t>>
+loaded_find(const LoadedData& loaded, std::string_view name) {
+    auto it = std::ranges::lower_bound(
+        loaded.index, name, std::less<>{}, [&](const LoadedFile& file) {
+            return loaded_file_name(loaded, file);
         }
-    }
-
-    if (result.data.empty()) {
-        error("No valid files found in ZIP archive");
+    );
+    if (it == loaded.index.end() || loaded_file_name(loaded, *it) != name)
         return std::nullopt;
-    }
-
-    return result;
+    return loaded_file_data(loaded, *it);
 }
 
-std::optional<LoadedData> load_resource(const std::string& path) {
-    auto reader = zip_init_from_file(path);
-    if (!reader) {
-        error(
-            "Failed to open ZIP file directly, trying to load file into memory"
-        );
-
-        std::ifstream file(path, std::ios::binary | std::ios::ate);
-        if (!file.is_open()) {
-            error("Failed to open file");
-            return std::nullopt;
+static std::optional<LoadedData>
+load_all_entries(std::unique_ptr<ZipReader> reader) {
+    LoadedData result;
+    auto* zip = reader.get();
+    uint32_t count = zip_get_file_count(zip);
+
+    // sized up front so every file and name is placed with no reallocation,
+    // entries sharing a payload get one slot in the arena and stored entries
+    // are not copied at all but point into the archive
+    //
+    // the payloads are a sorted flat table rather than a node per file, the
+    // first entry of each key is the one extracted
+    struct Blob {
+        BlobKey key;
+        uint32_t index;
+        uint64_t offset = 0;
+        bool in_archive = false;
+        bool extracted = false;
+    };
+    std::vector<Blob> blobs;
+    blobs.reserve(count);
+    size_t names_size = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        auto entry = zip_get_entry(zip, i);
+        if (!entry || entry->is_directory || entry->uncompressed_size == 0)
+            continue;
+        names_size += entry->name.size();
+        blobs.push_back({zip_blob_key(*entry), i});
+    }
+    std::ranges::sort(blobs, [](const Blob& a, const Blob& b) {
+        return std::tie(a.key, a.index) < std::tie(b.key, b.index);
+    });
+    auto shared = std::ranges::unique(blobs, std::equal_to<>{}, &Blob::key);
+    blobs.erase(shared.begin(), shared.end());
+    auto find_blob = [&](const BlobKey& key) -> const Blob& {
+        return *std::ranges::lower_bound(blobs, key, std::less<>{}, &Blob::key);
+    };
+
+    uint64_t arena_size = 0;
+    for (auto& blob : blobs) {
+        if (auto view = zip_stored_entry_view(zip, blob.index)) {
+            blob.offset = static_cast<uint64_t>(view->data() - zip->memory);
+            blob.in_archive = true;
+            blob.extracted = true;
+            continue;
         }
+        blob.offset = arena_size;
+        arena_size += blob.key.size;
+    }
+    result.arena.resize(static_cast<size_t>(arena_size));
+    result.names.reserve(names_size);
+    result.index.reserve(count);
 
-        std::streamsize size = file.tellg();
-        file.seekg(0, std::ios::beg);
-
-        std::vector<uint8_t> buffer(size);
-        if (!file.read(reinterpret_cast<char*>(buffer.data()), size)) {
-            error("Failed to read file");
-            return std::nullopt;
+    Decoder decoder;
+    for (auto& blob : blobs) {
+        if (blob.in_archive)
+            continue;
+        auto entry = zip_get_entry(zip, blob.index);
+        std::span<uint8_t> dst(
+            result.arena.data() + blob.offset,
+            static_cast<size_t>(entry->uncompressed_size)
+        );
+        blob.extracted = zip_extract_file_into(zip, blob.index, dst, decoder);
+        if (!blob.extracted) {
+            error(
+                std::format("Failed to extract data for {}", entry->name)
+                    .c_str()
+            );
         }
-
-        return load_resource_from_memory(buffer.data(), buffer.size());
     }
 
-    LoadedData result;
-    ZipReader* zip = reader.get();
-
-    for (uint32_t i = 0; i < zip_get_file_count(zip); ++i) {
-        auto info_opt = zip_get_file_info(zip, i);
-        if (!info_opt)
+    for (uint32_t i = 0; i < count; ++i) {
+        auto entry = zip_get_entry(zip, i);
+        if (!entry)
             continue;
 
-        const auto& info = *info_opt;
         info(
             std::format(
                 "File entry: {} | Compressed Size: {} | Uncompressed Size: {}",
-                info.filename,
-                info.compressed_size,
-                info.uncompressed_size
+                entry->name,
+                entry->compressed_size,
+                entry->uncompressed_size
             )
                 .c_str()
         );
 
-        if (info.uncompressed_size > 0 && !info.is_directory) {
-            auto data_opt = zip_extract_file_by_index(zip, i);
-            if (!data_opt || data_opt->empty()) {
-                error(
-                    std::format("Failed to extract data for {}", info.filename)
-                        .c_str()
-                );
-                continue;
-            }
-
-            result.data[info.filename] = std::move(*data_opt);
-        }
+        if (entry->is_directory || entry->uncompressed_size == 0)
+            continue;
+        const auto& blob = find_blob(zip_blob_key(*entry));
+        if (!blob.extracted)
+            continue;
+
+        result.index.push_back({
+            .name_offset = static_cast<uint32_t>(result.names.size()),
+            .name_size = static_cast<uint32_t>(entry->name.size()),
+            .data_offset = blob.offset,
+            .size = entry->uncompressed_size,
+            .in_archive = blob.in_archive,
+        });
+        result.names += entry->name;
     }
 
-    if (result.data.empty()) {
+    if (result.index.empty()) {
         error("No valid files found in ZIP archive");
         return std::nullopt;
     }
 
+    // a later entry of the same name replaces an earlier one, as the map did
+    std::ranges::stable_sort(
+        result.index, std::less<>{}, [&](const LoadedFile& file) {
+            return loaded_file_name(result, file);
+        }
+    );
+    auto duplicates = std::ranges::unique(
+        result.index.rbegin(),
+        result.index.rend(),
+        std::equal_to<>{},
+        [&](const LoadedFile& file) { return loaded_file_name(result, file); }
+    );
+    result.index.erase(result.index.begin(), duplicates.begin().base());
+
+    result.reader = std::move(reader);
     return result;
 }
 
-std::string write_to_temp_file(
-    const unsigned char* data,
-    size_t data_size,
-    const std::string& ext
-) {
-    namespace fs = std::filesystem;
-
-    std::string temp_name =
-        "bundle_" + std::to_string(std::random_device{}()) + ext;
-    fs::path temp_path = fs::temp_directory_path() / temp_name;
-
-    std::ofstream out(temp_path, std::ios::binary);
-    if (!out) {
-        return "";
+std::optional<LoadedData>
+load_resource_from_memory(const unsigned char* buffer, size_t buffer_size) {
+    auto reader = zip_init_from_buffer(buffer, buffer_size);
+    if (!reader) {
+        error("Failed to initialize ZIP archive from memory");
+        return std::nullopt;
     }
 
-    out.write(reinterpret_cast<const char*>(data), data_size);
-    out.close();
-
-    temp_files.push_back(temp_path.string());
-
-    return temp_path.string();
+    return load_all_entries(std::move(reader));
 }
 
-bool remove_temp_file(const std::string& path) {
-    if (path.empty())
-        return true;
-    std::error_code ec;
-    return std::filesystem::remove(path, ec);
-}
-
-bool remove_all_temp_files() {
-    int errors = 0;
-    for (const auto& file : temp_files) {
-        if (!remove_temp_file(file)) {
-            errors++;
-            error(std::format("error removing: {}", file).c_str());
-        }
-        info(std::format("{} removed correctly", file).c_str());
-    }
-    if (errors > 0) {
-        return false;
+std::optional<LoadedData> load_resource(const std::string& path) {
+    // zip_init_from_file already falls back to reading the file when it
+    // cannot be mapped, a failure here means the archive itself is unusable
+    auto reader = zip_init_from_file(path);
+    if (!reader) {
+        error(std::format("Failed to open ZIP file {}", path).c_str());
+        return std::nullopt;
     }
 
-    return true;
+    return load_all_entries(std::move(reader));
 }
 
 }  // namespace encoding
\ No newline at end of file
@@ -8,9 +8,12 @@
 #include <fstream>
 #include <map>
 #include <optional>
-#include <random>
 #include <string>
 #include "../main.hpp"
+#include "codec.hpp"
+#include "crc32.hpp"
+#include "kpack.hpp"
+#include "mapped_file.hpp"
 
 namespace encoding {
 
@@ -26,13 +29,91 @@ struct ZipFileInfo {
     uint32_t crc32;
     bool is_directory;
     uint16_t method;
+    Codec codec;
     mz_zip_archive_file_stat mz_stat;
 };
 
+/// chunk index of entries that are not part of a solid chunk
+constexpr uint32_t NO_CHUNK = UINT32_MAX;
+
+/// view of one archive entry handed out by the index, `name` points into the
+/// reader's name pool and stays valid as long as the reader does
+struct ZipEntry {
+    std::string_view name;
+    uint64_t uncompressed_size;
+    uint64_t compressed_size;
+    /// for konduit packs this is the payload offset, they have no local
+    /// headers, for solid entries it is the offset into the decoded chunk
+    uint64_t local_header_offset;
+    uint32_t crc32;
+    uint32_t index;
+    /// solid chunk holding the entry, NO_CHUNK for entries stored on their own
+    uint32_t chunk;
+    uint16_t method;
+    Codec codec;
+    bool is_directory;
+};
+
+/// identifies the payload behind an entry, konduit_pack stores identical
+/// files once so several entries can share one key and decode to the same
+/// bytes
+struct BlobKey {
+    uint32_t chunk;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t crc32;
+
+    auto operator<=>(const BlobKey&) const = default;
+};
+
+BlobKey zip_blob_key(const ZipEntry& entry);
+
+/// central directory flattened once at open time, entry i lives at slot i of
+/// every array and names are resolved through an open-addressing hash table
+struct ZipIndex {
+    std::string names;
+    std::vector<uint32_t> name_offsets;
+    std::vector<uint64_t> name_hashes;
+    std::vector<uint64_t> uncompressed_sizes;
+    std::vector<uint64_t> compressed_sizes;
+    std::vector<uint64_t> local_header_offsets;
+    std::vector<uint32_t> crc32s;
+    std::vector<uint16_t> methods;
+    std::vector<uint8_t> directories;
+    /// entry index + 1, 0 marks an empty slot, size is a power of two
+    std::vector<uint32_t> slots;
+};
+
+/// the last solid chunk decoded, entries sharing it are served without
+/// decoding it again, keep one per thread
+struct ChunkCache {
+    uint32_t chunk = NO_CHUNK;
+    std::vector<uint8_t> data;
+};
+
+enum class BundleFormat {
+    ZIP,
+    KPACK,
+};
+
+/// reads zip archives through miniz and konduit packs in place, the format is
+/// picked from the leading magic when the reader is opened
 struct ZipReader {
+    BundleFormat format;
     mz_zip_archive archive;
+    /// table of contents of a konduit pack, unset for zip archives
+    std::optional<PackView> pack;
     std::vector<uint8_t> file_buffer;
+    std::unique_ptr<MappedFile> mapping;
+    /// central directory index of a zip archive, packs carry their own
+    ZipIndex index;
+    /// the archive bytes miniz reads from, the caller's buffer, the mapping or
+    /// file_buffer, extra archive views can be opened over it
+    const uint8_t* memory;
+    size_t memory_size;
     bool owns_buffer;
+    /// solid chunk cache of zip_extract_file_by_index
+    ChunkCache chunk_cache;
     uint32_t current_index;
     uint32_t total_files;
 
@@ -57,15 +138,59 @@ zip_init_from_buffer(const unsigned char* buffer, size_t size);
 std::unique_ptr<ZipReader> zip_init_from_file(std::string_view filepath);
 
 std::optional<ZipFileInfo> zip_get_file_info(ZipReader* reader, uint32_t index);
+std::optional<ZipEntry> zip_get_entry(const ZipReader* reader, uint32_t index);
+std::optional<ZipEntry>
+zip_find_entry(const ZipReader* reader, std::string_view filename);
 std::optional<ZipFileInfo> zip_current_file_info(ZipReader* reader);
 bool zip_next_file(ZipReader* reader);
 void zip_reset(ZipReader* reader);
 bool zip_has_more_files(ZipReader* reader);
 uint32_t zip_get_file_count(ZipReader* reader);
 
+/// the entry's compressed bytes inside the archive memory, no copy is made,
+/// solid entries have no bytes of their own and yield nullopt
+std::optional<std::span<const uint8_t>>
+zip_entry_data(const ZipReader* reader, const ZipEntry& entry);
+
+uint32_t zip_get_chunk_count(const ZipReader* reader);
+
+/// decodes a solid chunk into `cache` unless it already holds it
+bool zip_load_chunk(
+    const ZipReader* reader,
+    uint32_t chunk,
+    Decoder& decoder,
+    ChunkCache& cache
+);
+
+/// streams the decoded entry through `sink` and checks the result against the
+/// size and CRC-32 recorded in the central directory, solid entries are
+/// served from `cache`, without one their whole chunk is decoded per call
+bool zip_decode_entry(
+    const ZipReader* reader,
+    const ZipEntry& entry,
+    Decoder& decoder,
+    const DecodeSink& sink,
+    ChunkCache* cache = nullptr
+);
+
 std::optional<std::vector<uint8_t>> zip_extract_current_file(ZipReader* reader);
 std::optional<std::vector<uint8_t>>
 zip_extract_file_by_index(ZipReader* reader, uint32_t index);
+/// bytes of a stored entry straight from the archive memory, the embedded
+/// bundle or the mapping, nullopt for compressed and solid entries
+///
+/// nothing is copied or read and the CRC-32 is not checked, the view lives
+/// as long as the reader
+std::optional<std::span<const uint8_t>>
+zip_stored_entry_view(const ZipReader* reader, uint32_t index);
+/// decodes and verifies the entry straight into `dst`, which has to be
+/// exactly its uncompressed size
+bool zip_extract_file_into(
+    ZipReader* reader,
+    uint32_t index,
+    std::span<uint8_t> dst,
+    Decoder& decoder
+);
 std::optional<std::vector<uint8_t>>
 zip_extract_file_by_name(ZipReader* reader, std::string_view filename);
 std::optional<uint32_t>
@@ -74,25 +199,47 @@ zip_find_file_index(ZipReader* reader, std::string_view filename);
 ZipIterator begin(ZipReader* reader);
 ZipIterator end(ZipReader* reader);
 
+struct LoadedFile {
+    uint32_t name_offset;
+    uint32_t name_size;
+    /// into the arena, or into the archive for files `in_archive`
+    uint64_t data_offset;
+    uint64_t size;
+    bool in_archive;
+};
+
+/// every loaded file in one contiguous arena and every name in one string,
+/// `index` is sorted by name and points into both, files with the same
+/// contents share their bytes
+///
+/// stored entries are not copied, their views point straight into the
+/// embedded bundle or the mapped archive kept open by `reader`, and are not
+/// checked against their CRC-32 so that their pages are only read when used
+///
+/// a whole bundle costs a handful of allocations no matter how many files it
+/// holds, the views stay valid as long as the LoadedData lives and is not
+/// modified
 struct LoadedData {
-    std::map<std::string, std::vector<uint8_t>> data;
+    std::vector<uint8_t> arena;
+    std::string names;
+    std::vector<LoadedFile> index;
+    std::unique_ptr<ZipReader> reader;
 };
 
+std::span<const uint8_t>
+loaded_file_data(const LoadedData& loaded, const LoadedFile& file);
+std::string_view
+loaded_file_name(const LoadedData& loaded, const LoadedFile& file);
+
+/// binary search of the index, nullopt when no file has that name
+std::optional<std::span<const uint8_t>>
+loaded_find(const LoadedData& loaded, std::string_view name);
+
 std::optional<LoadedData>
 load_resource_from_memory(const unsigned char* buffer, size_t buffer_size);
 
 std::optional<LoadedData> load_resource(const std::string& path);
 
-static std::vector<std::string> temp_files;
-
-std::string write_to_temp_file(
-    const unsigned char* data,
-    size_t data_size,
-    const std::string& ext
-);
-bool remove_temp_file(const std::string& path);
-bool remove_all_temp_files();
-
 }  // namespace encoding
 
 #endif  // KONDUIT_INSTALLER_ENCODING_HANDLING_HPP
\ No newline at end of file
@@ -0,0 +1,742 @@
+#include "extraction.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace encoding {
+
+namespace fs = std::filesystem;
+
+struct StreamSink {
+    std::ofstream* out;
+    std::vector<uint8_t>* buffer;
+    size_t used;
+    uint64_t written;
+};
+
+static bool flush_sink(StreamSink& sink) {
+    if (sink.used == 0)
+        return true;
+    sink.out->write(
+        reinterpret_cast<const char*>(sink.buffer->data()), sink.used
+    );
+    sink.written += sink.used;
+    sink.used = 0;
+    return sink.out->good();
+}
+
+static bool stream_chunk(StreamSink& sink, const uint8_t* src, size_t n) {
+    auto capacity = sink.buffer->size();
+
+    // chunks bigger than the staging buffer (stored entries served straight
+    // from the archive memory) skip the copy
+    if (n >= capacity) {
+        if (!flush_sink(sink))
+            return false;
+        sink.out->write(reinterpret_cast<const char*>(src), n);
+        sink.written += n;
+        return sink.out->good();
+    }
+
+    while (n > 0) {
+        size_t chunk = std::min(n, capacity - sink.used);
+        std::memcpy(sink.buffer->data() + sink.used, src, chunk);
+        sink.used += chunk;
+        src += chunk;
+        n -= chunk;
+        if (sink.used == capacity && !flush_sink(sink))
+            return false;
+    }
+    return true;
+}
+
+std::optional<fs::path> resolve_entry_path(
+    const fs::path& install_path,
+    std::string_view entry_name
+) {
+    fs::path relative = fs::path(entry_name).lexically_normal();
+    if (relative.empty() || relative.is_absolute() ||
+        relative.has_root_name() || relative.has_root_directory()) {
+        return nullopt;
+    }
+    for (const auto& part : relative) {
+        if (part == "..")
+            return nullopt;
+    }
+    return install_path / relative;
+}
+
+// the parent directory has to exist, plan_extraction creates them all up
+// front
+static bool stream_entry(
+    const ZipReader* reader,
+    uint32_t index,
+    const fs::path& destination,
+    std::vector<uint8_t>& buffer,
+    Decoder& decoder,
+    ChunkCache& cache
+) {
+    auto entry = zip_get_entry(reader, index);
+    if (!entry)
+        return false;
+
+    std::ofstream out(destination, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error(std::format("Failed to open {}", destination.string()).c_str());
+        return false;
+    }
+
+    StreamSink sink{&out, &buffer, 0, 0};
+    bool ok = zip_decode_entry(
+                  reader,
+                  *entry,
+                  decoder,
+                  [&](const uint8_t* data, size_t n) {
+                      return stream_chunk(sink, data, n);
+                  },
+                  &cache
+              ) &&
+              flush_sink(sink);
+    out.close();
+
+    if (!ok || out.fail()) {
+        std::error_code ec;
+        fs::remove(destination, ec);
+        return false;
+    }
+    return true;
+}
+
+bool extract_entry_to_file(
+    ZipReader* reader,
+    uint32_t index,
+    const fs::path& destination,
+    std::vector<uint8_t>& buffer
+) {
+    if (!reader || index >= reader->total_files || buffer.empty())
+        return false;
+
+    // no planner ran, so the parent may still be missing
+    std::error_code ec;
+    fs::create_directories(destination.parent_path(), ec);
+    if (ec) {
+        error(
+            std::format(
+                "Failed to create {}: {}",
+                destination.parent_path().string(),
+                ec.message()
+            )
+                .c_str()
+        );
+        return false;
+    }
+
+    Decoder decoder;
+    ChunkCache cache;
+    return stream_entry(reader, index, destination, buffer, decoder, cache);
+}
+
+uint32_t resolve_thread_count(uint32_t requested, size_t jobs) {
+    uint32_t threads = requested;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<uint32_t>(
+        std::min<size_t>(threads, std::max<size_t>(jobs, 1))
+    );
+}
+
+static std::vector<ExtractBatch> plan_batches(std::vector<ExtractJob>& jobs) {
+    // solid entries are grouped by chunk, NO_CHUNK sorts last and keeps the
+    // standalone entries in their order
+    std::stable_sort(
+        jobs.begin(),
+        jobs.end(),
+        [](const ExtractJob& a, const ExtractJob& b) {
+            return a.chunk < b.chunk;
+        }
+    );
+
+    std::vector<ExtractBatch> batches;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        bool same_chunk = !batches.empty() && jobs[i].chunk != NO_CHUNK &&
+                          jobs[i].chunk == jobs[i - 1].chunk;
+        if (!same_chunk)
+            batches.push_back({i, i, 0});
+        batches.back().end = i + 1;
+        batches.back().size += jobs[i].size;
+    }
+    return batches;
+}
+
+static void run_serial(
+    ZipReader* reader,
+    const std::vector<ExtractJob>& jobs,
+    size_t buffer_size,
+    ExtractResult& result
+) {
+    std::vector<uint8_t> buffer(buffer_size);
+    Decoder decoder;
+    ChunkCache cache;
+    for (const auto& job : jobs) {
+        if (!stream_entry(
+                reader, job.index, job.destination, buffer, decoder, cache
+            )) {
+            error(std::format("Failed to extract {}", job.name).c_str());
+            result.failed.push_back(job.name);
+            continue;
+        }
+        result.files_written++;
+        result.bytes_written += job.size;
+    }
+}
+
+static void run_parallel(
+    ZipReader* reader,
+    const std::vector<ExtractJob>& jobs,
+    const std::vector<ExtractBatch>& batches,
+    size_t buffer_size,
+    uint32_t thread_count,
+    ExtractResult& result
+) {
+    std::atomic<size_t> next{0};
+    std::atomic<uint32_t> files_written{0};
+    std::atomic<uint64_t> bytes_written{0};
+    std::mutex failed_mutex;
+
+    auto worker = [&] {
+        // entries are decoded straight from the shared archive memory through
+        // the read-only index, only the decoder, chunk cache and staging
+        // buffer are per worker
+        Decoder decoder;
+        ChunkCache cache;
+        std::vector<uint8_t> buffer(buffer_size);
+        for (size_t b = next++; b < batches.size(); b = next++) {
+            for (size_t i = batches[b].begin; i < batches[b].end; ++i) {
+                const auto& job = jobs[i];
+                if (!stream_entry(
+                        reader,
+                        job.index,
+                        job.destination,
+                        buffer,
+                        decoder,
+                        cache
+                    )) {
+                    error(
+                        std::format("Failed to extract {}", job.name).c_str()
+                    );
+                    std::lock_guard lock(failed_mutex);
+                    result.failed.push_back(job.name);
+                    continue;
+                }
+                files_written++;
+                bytes_written += job.size;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(thread_count);
+    for (uint32_t t = 0; t < thread_count; ++t) {
+        pool.emplace_back(worker);
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    result.files_written += files_written;
+    result.bytes_written += bytes_written;
+}
+
+static bool is_unchanged(
+    const ZipEntry& entry,
+    const fs::path& destination,
+    const Manifest& installed
+) {
+    auto it = installed.find(entry.name);
+    if (it == installed.end() || it->second.size != entry.uncompressed_size ||
+        it->second.crc32 != entry.crc32) {
+        return false;
+    }
+    // catches files deleted or truncated since the last install without
+    // having to hash them
+    std::error_code ec;
+    auto size = fs::file_size(destination, ec);
+    return !ec && size == entry.uncompressed_size;
+}
+
+// where `destination` below the install path is written in a staged install
+static fs::path staged_path(
+    const fs::path& destination,
+    const fs::path& install_path,
+    const fs::path& staging
+) {
+    return staging / destination.lexically_relative(install_path);
+}
+
+// below these a level of the tree or a metadata pass is not worth a thread
+constexpr size_t DIRECTORIES_PER_THREAD = 32;
+constexpr size_t METADATA_PER_THREAD = 64;
+
+// runs `work` for every index below `count`, spread over up to `threads`
+// threads that each get at least `min_per_thread` of them
+template <typename Work>
+static void parallel_for(
+    size_t count,
+    uint32_t threads,
+    size_t min_per_thread,
+    const Work& work
+) {
+    uint32_t thread_count = resolve_thread_count(
+        threads, count / std::max<size_t>(min_per_thread, 1)
+    );
+    if (thread_count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            work(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> pool;
+    pool.reserve(thread_count);
+    for (uint32_t t = 0; t < thread_count; ++t) {
+        pool.emplace_back([&] {
+            for (size_t i = next++; i < count; i = next++) {
+                work(i);
+            }
+        });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+// the mode bits and modification time the archive records for entry `index`,
+// zip entries only carry unix mode bits when they were made on unix
+static EntryMetadata
+entry_metadata(ZipReader* reader, uint32_t index, const fs::path& path) {
+    constexpr int MADE_BY_UNIX = 3;
+    EntryMetadata metadata{path, 0, 0};
+    if (auto info = zip_get_file_info(reader, index)) {
+        const auto& stat = info->mz_stat;
+        if ((stat.m_version_made_by >> 8) == MADE_BY_UNIX)
+            metadata.mode = (stat.m_external_attr >> 16) & 0777;
+        metadata.mtime = static_cast<int64_t>(stat.m_time);
+    }
+    return metadata;
+}
+
+// `directories` and every ancestor of them below the install path, grouped
+// by depth and sorted within each level
+static std::vector<std::vector<fs::path>> directory_levels(
+    const std::vector<fs::path>& directories,
+    const fs::path& install_path
+) {
+    std::vector<std::vector<fs::path>> levels;
+    for (const auto& dir : directories) {
+        fs::path relative = dir.lexically_relative(install_path);
+        fs::path prefix = install_path;
+        size_t depth = 0;
+        for (const auto& part : relative) {
+            if (part.empty() || part == ".")
+                continue;
+            prefix /= part;
+            if (levels.size() <= depth)
+                levels.resize(depth + 1);
+            levels[depth++].push_back(prefix);
+        }
+    }
+    for (auto& level : levels) {
+        std::sort(level.begin(), level.end());
+        level.erase(std::unique(level.begin(), level.end()), level.end());
+    }
+    return levels;
+}
+
+// creates the directories one level of the tree after the other, so every
+// parent exists and the directories of a level can be created side by side,
+// only the ones missing from the install count when they are staged
+static void create_directory_levels(
+    const std::vector<std::vector<fs::path>>& levels,
+    const fs::path& install_path,
+    const fs::path* staging,
+    uint32_t threads,
+    ExtractResult& result
+) {
+    std::atomic<uint32_t> created{0};
+    for (const auto& level : levels) {
+        auto create = [&](size_t i) {
+            const auto& dir = level[i];
+            auto target =
+                staging ? staged_path(dir, install_path, *staging) : dir;
+            std::error_code ec;
+            bool missing = !staging || !fs::is_directory(dir, ec);
+            if (fs::create_directory(target, ec) && missing)
+                created++;
+            if (ec) {
+                error(
+                    std::format(
+                        "Failed to create {}: {}", target.string(), ec.message()
+                    )
+                        .c_str()
+                );
+            }
+        };
+        parallel_for(level.size(), threads, DIRECTORIES_PER_THREAD, create);
+    }
+    result.directories_created += created;
+}
+
+void apply_metadata(
+    const std::vector<EntryMetadata>& entries,
+    uint32_t threads
+) {
+    auto apply = [&](size_t i) {
+        const auto& entry = entries[i];
+        std::error_code ec;
+        if (entry.mode != 0) {
+            fs::permissions(
+                entry.path,
+                static_cast<fs::perms>(entry.mode),
+                fs::perm_options::replace,
+                ec
+            );
+        }
+        if (entry.mtime != 0) {
+            std::chrono::sys_seconds mtime{std::chrono::seconds(entry.mtime)};
+            fs::last_write_time(
+                entry.path, std::chrono::file_clock::from_sys(mtime), ec
+            );
+        }
+    };
+    parallel_for(entries.size(), threads, METADATA_PER_THREAD, apply);
+}
+
+std::optional<ExtractPlan> plan_extraction(
+    ZipReader* reader,
+    const fs::path& install_path,
+    ExtractResult& result,
+    const Manifest* installed,
+    const fs::path* staging,
+    uint32_t threads
+) {
+    if (!reader) {
+        error("Invalid ZIP reader");
+        return nullopt;
+    }
+
+    std::error_code ec;
+    fs::create_directories(staging ? *staging : install_path, ec);
+    if (ec) {
+        error(
+            std::format(
+                "Failed to create install path {}: {}",
+                install_path.string(),
+                ec.message()
+            )
+                .c_str()
+        );
+        return nullopt;
+    }
+
+    // flat and sorted once the entries are in, not a node per file
+    ExtractPlan plan;
+    std::vector<fs::path> directories;
+    std::vector<std::pair<BlobKey, size_t>> blobs;
+    blobs.reserve(zip_get_file_count(reader));
+
+    for (uint32_t i = 0; i < zip_get_file_count(reader); ++i) {
+        auto entry = zip_get_entry(reader, i);
+        if (!entry)
+            continue;
+
+        auto destination = resolve_entry_path(install_path, entry->name);
+        if (!destination) {
+            error(
+                std::format("Refusing to extract unsafe path {}", entry->name)
+                    .c_str()
+            );
+            result.failed.emplace_back(entry->name);
+            continue;
+        }
+
+        if (entry->is_directory) {
+            directories.push_back(*destination);
+            plan.directory_metadata.push_back(
+                entry_metadata(reader, i, *destination)
+            );
+            continue;
+        }
+
+        if (installed && is_unchanged(*entry, *destination, *installed)) {
+            result.files_unchanged++;
+            continue;
+        }
+
+        // files of a directory mostly follow each other
+        auto parent = destination->parent_path();
+        if (directories.empty() || directories.back() != parent)
+            directories.push_back(std::move(parent));
+        bool replace = false;
+        if (staging) {
+            destination = staged_path(*destination, install_path, *staging);
+        } else if (installed) {
+            std::error_code exists_ec;
+            replace = fs::exists(*destination, exists_ec);
+        }
+        plan.file_metadata.push_back(entry_metadata(reader, i, *destination));
+
+        if (entry->uncompressed_size > 0)
+            blobs.emplace_back(zip_blob_key(*entry), plan.jobs.size());
+        plan.jobs.push_back(
+            {i,
+             entry->chunk,
+             entry->uncompressed_size,
+             std::move(*destination),
+             std::string(entry->name),
+             replace}
+        );
+    }
+
+    // the first job of every payload writes it, the others turn into links
+    // to it, the jobs keep their archive order
+    std::ranges::sort(blobs);
+    std::vector<uint8_t> linked(plan.jobs.size());
+    size_t source = 0;
+    for (size_t i = 0; i < blobs.size(); ++i) {
+        const auto& [key, job] = blobs[i];
+        if (i == 0 || blobs[i - 1].first != key) {
+            source = job;
+            continue;
+        }
+        // every job got its metadata in order, before any became a link
+        const auto& source_metadata = plan.file_metadata[source];
+        const auto& metadata = plan.file_metadata[job];
+        auto& duplicate = plan.jobs[job];
+        plan.links.push_back(
+            {plan.jobs[source].destination,
+             plan.jobs[source].name,
+             duplicate.size,
+             std::move(duplicate.destination),
+             std::move(duplicate.name),
+             metadata.mode == source_metadata.mode &&
+                 metadata.mtime == source_metadata.mtime,
+             false}
+        );
+        linked[job] = 1;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < plan.jobs.size(); ++i) {
+        if (!linked[i])
+            plan.jobs[kept++] = std::move(plan.jobs[i]);
+    }
+    plan.jobs.resize(kept);
+
+    std::ranges::sort(directories);
+    directories.erase(
+        std::unique(directories.begin(), directories.end()), directories.end()
+    );
+    // directories are created up front so workers never race on them
+    create_directory_levels(
+        directory_levels(directories, install_path),
+        install_path,
+        staging,
+        threads,
+        result
+    );
+
+    plan.batches = plan_batches(plan.jobs);
+    // biggest batches first so a large file picked up late does not leave
+    // the rest of the pool idle
+    std::stable_sort(
+        plan.batches.begin(),
+        plan.batches.end(),
+        [](const ExtractBatch& a, const ExtractBatch& b) {
+            return a.size > b.size;
+        }
+    );
+    return plan;
+}
+
+static bool reflink_file(const fs::path& source, const fs::path& destination) {
+#if defined(__linux__)
+    int src = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src < 0)
+        return false;
+    int dst = open(
+        destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644
+    );
+    if (dst < 0) {
+        close(src);
+        return false;
+    }
+    bool ok = ioctl(dst, FICLONE, src) == 0;
+    close(src);
+    close(dst);
+    if (!ok) {
+        std::error_code ec;
+        fs::remove(destination, ec);
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
+void link_duplicates(ExtractPlan& plan, bool hardlinks, ExtractResult& result) {
+    std::set<std::string_view> failed(
+        result.failed.begin(), result.failed.end()
+    );
+
+    for (auto& link : plan.links) {
+        if (failed.contains(link.source_name)) {
+            error(
+                std::format(
+                    "Failed to extract {}: {} failed",
+                    link.name,
+                    link.source_name
+                )
+                    .c_str()
+            );
+            result.failed.push_back(link.name);
+            continue;
+        }
+
+        // an older file in the way may itself be a hardlink, replacing it
+        // keeps the other names intact
+        std::error_code ec;
+        fs::remove(link.destination, ec);
+
+        // a hardlink shares the source's inode and with it mode and mtime,
+        // whichever was applied last would win for both
+        bool ok = reflink_file(link.source, link.destination);
+        if (!ok && hardlinks && link.same_metadata) {
+            fs::create_hard_link(link.source, link.destination, ec);
+            ok = !ec;
+        }
+        if (!ok) {
+            ec.clear();
+            fs::copy_file(
+                link.source,
+                link.destination,
+                fs::copy_options::overwrite_existing,
+                ec
+            );
+            ok = !ec;
+        }
+
+        if (!ok) {
+            error(
+                std::format(
+                    "Failed to create {} from {}: {}",
+                    link.name,
+                    link.source_name,
+                    ec.message()
+                )
+                    .c_str()
+            );
+            result.failed.push_back(link.name);
+            continue;
+        }
+        link.done = true;
+        result.files_linked++;
+        result.bytes_written += link.size;
+    }
+}
+
+void remove_stale_files(
+    const fs::path& install_path,
+    const Manifest& installed,
+    const Manifest& bundle,
+    ExtractResult& result
+) {
+    std::error_code ec;
+    for (const auto& [name, entry] : installed) {
+        if (bundle.contains(name))
+            continue;
+        auto path = resolve_entry_path(install_path, name);
+        if (!path)
+            continue;
+
+        if (fs::remove(*path, ec)) {
+            result.files_removed++;
+        } else if (ec) {
+            error(
+                std::format("Failed to remove {}: {}", name, ec.message())
+                    .c_str()
+            );
+            continue;
+        }
+
+        // fs::remove refuses directories that still have files in them,
+        // which ends the walk up, it never leaves the install path
+        for (auto dir = fs::path(name).lexically_normal().parent_path();
+             !dir.empty() && fs::remove(install_path / dir, ec);
+             dir = dir.parent_path()) {
+        }
+        ec.clear();
+    }
+}
+
+std::optional<ExtractResult> extract_to_directory(
+    ZipReader* reader,
+    const fs::path& install_path,
+    const ExtractOptions& options
+) {
+    ExtractResult result;
+    auto plan = plan_extraction(
+        reader, install_path, result, nullptr, nullptr, options.threads
+    );
+    if (!plan)
+        return nullopt;
+
+    size_t buffer_size = std::max<size_t>(options.buffer_size, 1);
+    uint32_t thread_count =
+        resolve_thread_count(options.threads, plan->batches.size());
+
+    if (thread_count <= 1) {
+        run_serial(reader, plan->jobs, buffer_size, result);
+    } else {
+        run_parallel(
+            reader,
+            plan->jobs,
+            plan->batches,
+            buffer_size,
+            thread_count,
+            result
+        );
+    }
+    link_duplicates(*plan, options.hardlinks, result);
+    apply_metadata(plan->file_metadata, options.threads);
+    apply_metadata(plan->directory_metadata, options.threads);
+
+    info(
+        std::format(
+            "Extracted {} files, {} linked ({} bytes) into {} on {} threads, "
+            "{} failed",
+            result.files_written,
+            result.files_linked,
+            result.bytes_written,
+            install_path.string(),
+            thread_count,
+            result.failed.size()
+        )
+            .c_str()
+    );
+
+    return result;
+}
+
+}  // namespace encoding
@@ -0,0 +1,174 @@
+#ifndef KONDUIT_INSTALLER_EXTRACTION_HPP
+#define KONDUIT_INSTALLER_EXTRACTION_HPP
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include "encoding_handling.hpp"
+#include "manifest.hpp"
+
+namespace encoding {
+
+/// size of the staging buffer every entry is streamed through, the memory
+/// used by an extraction does not depend on the size of the bundle
+constexpr size_t EXTRACT_BUFFER_SIZE = 256 * 1024;
+
+struct ExtractOptions {
+    size_t buffer_size = EXTRACT_BUFFER_SIZE;
+    /// worker threads used to extract entries, 1 keeps the extraction on the
+    /// calling thread, 0 uses every hardware thread
+    uint32_t threads = 1;
+    /// let duplicate files become hardlinks when reflinks are unsupported,
+    /// they then share later modifications too
+    bool hardlinks = true;
+};
+
+struct ExtractResult {
+    uint32_t files_written = 0;
+    uint32_t directories_created = 0;
+    /// files an update left alone because they match the installed manifest
+    uint32_t files_unchanged = 0;
+    /// files of the previous install that are no longer in the bundle
+    uint32_t files_removed = 0;
+    /// duplicate files written as a reflink, hardlink or copy of another one
+    uint32_t files_linked = 0;
+    uint64_t bytes_written = 0;
+    std::vector<std::string> failed;
+};
+
+/// joins an archive entry name onto the install path, rejects absolute names
+/// and names escaping the install path through ".."
+std::optional<std::filesystem::path> resolve_entry_path(
+    const std::filesystem::path& install_path,
+    std::string_view entry_name
+);
+
+/// streams a single entry into `destination` through `buffer`, the file is
+/// removed again if the extraction fails halfway
+bool extract_entry_to_file(
+    ZipReader* reader,
+    uint32_t index,
+    const std::filesystem::path& destination,
+    std::vector<uint8_t>& buffer
+);
+
+uint32_t resolve_thread_count(uint32_t requested, size_t jobs);
+
+struct ExtractJob {
+    uint32_t index;
+    uint32_t chunk;
+    uint64_t size;
+    std::filesystem::path destination;
+    std::string name;
+    /// an older file is in the way, it is unlinked instead of truncated so
+    /// files hardlinked to it keep their contents
+    bool replace;
+};
+
+/// a file with the same payload as the job writing `source`, created from
+/// it once that is written
+struct ExtractLink {
+    std::filesystem::path source;
+    std::string source_name;
+    uint64_t size;
+    std::filesystem::path destination;
+    std::string name;
+    /// mode and mtime match the source's, only then may the two share an
+    /// inode through a hardlink
+    bool same_metadata;
+    bool done;
+};
+
+/// what an entry is left with once it is written
+struct EntryMetadata {
+    std::filesystem::path path;
+    /// permission bits, setuid, setgid and sticky never apply, 0 leaves the
+    /// default
+    uint32_t mode;
+    /// seconds since the epoch, 0 leaves the time it was written
+    int64_t mtime;
+};
+
+/// jobs [begin, end) handed to one worker, all entries of a solid chunk
+/// share a batch so the chunk is decoded once
+struct ExtractBatch {
+    size_t begin;
+    size_t end;
+    uint64_t size;
+};
+
+/// the files of an archive grouped by solid chunk, batches are ordered
+/// largest first
+struct ExtractPlan {
+    std::vector<ExtractJob> jobs;
+    std::vector<ExtractBatch> batches;
+    std::vector<ExtractLink> links;
+    /// for every planned file at the path it is written to
+    std::vector<EntryMetadata> file_metadata;
+    /// for the directory entries of the archive, at their install path
+    std::vector<EntryMetadata> directory_metadata;
+};
+
+/// resolves every entry under `install_path` and creates all directories up
+/// front, one level of the tree after the other with the directories of a
+/// level spread over `threads`, unsafe names and directories that could not
+/// be created are recorded in `result`
+///
+/// with an `installed` manifest, files whose size and CRC-32 match it and
+/// whose size on disk still matches are left out of the plan
+///
+/// entries sharing a payload are decoded once, all but the first become
+/// links
+///
+/// with a `staging` directory the files and directories are planned and
+/// created below it instead, the install path itself is left untouched
+std::optional<ExtractPlan> plan_extraction(
+    ZipReader* reader,
+    const std::filesystem::path& install_path,
+    ExtractResult& result,
+    const Manifest* installed = nullptr,
+    const std::filesystem::path* staging = nullptr,
+    uint32_t threads = 1
+);
+
+/// sets the recorded mode bits and modification times on `threads` threads,
+/// entries that are gone are skipped, directories go last as writing into
+/// them moves their times again
+void apply_metadata(
+    const std::vector<EntryMetadata>& entries,
+    uint32_t threads
+);
+
+/// creates the planned links whose source was written, as a reflink where the
+/// filesystem supports it, else a hardlink when allowed and the two have the
+/// same metadata, else a copy
+void link_duplicates(
+    ExtractPlan& plan,
+    bool hardlinks,
+    ExtractResult& result
+);
+
+/// deletes the files of the `installed` manifest that are missing from
+/// `bundle`, along with directories left empty by that, and counts them in
+/// `result`
+void remove_stale_files(
+    const std::filesystem::path& install_path,
+    const Manifest& installed,
+    const Manifest& bundle,
+    ExtractResult& result
+);
+
+/// extracts every entry of the archive under `install_path` without ever
+/// holding a whole entry in memory (solid chunks excepted), with
+/// `options.threads` != 1 the entries are spread over a worker pool, largest
+/// first, with each solid chunk decoded once by a single worker
+std::optional<ExtractResult> extract_to_directory(
+    ZipReader* reader,
+    const std::filesystem::path& install_path,
+    const ExtractOptions& options = {}
+);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_EXTRACTION_HPP
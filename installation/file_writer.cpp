@@ -0,0 +1,1043 @@
+#include "file_writer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#if defined(__linux__)
+#include <linux/falloc.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <thread>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && \
+    defined(__NR_io_uring_register)
+#define KONDUIT_IO_URING 1
+#endif
+#endif
+
+namespace encoding {
+
+namespace fs = std::filesystem;
+
+const char* write_backend_name(WriteBackend backend) {
+    switch (backend) {
+        case WriteBackend::AUTO:
+            return "auto";
+        case WriteBackend::IO_URING:
+            return "io_uring";
+        case WriteBackend::THREADS:
+            return "threads";
+    }
+    return "unknown";
+}
+
+/// part of a block that is either written or left as a hole
+struct BlockRange {
+    size_t begin;
+    size_t end;
+    bool hole;
+};
+
+static bool all_zero(const uint8_t* data, size_t size) {
+    return data[0] == 0 && std::memcmp(data, data + 1, size - 1) == 0;
+}
+
+// splits a block that goes to `offset` of its file into the ranges to write,
+// runs of at least SPARSE_MIN_RUN zero bytes on SPARSE_ALIGNMENT boundaries
+// of the file become holes
+static void split_block(
+    std::span<const uint8_t> data,
+    uint64_t offset,
+    bool sparse,
+    std::vector<BlockRange>& ranges
+) {
+    ranges.clear();
+    size_t written = 0;
+    auto end_run = [&](size_t begin, size_t end) {
+        if (end - begin < SPARSE_MIN_RUN)
+            return;
+        if (written < begin)
+            ranges.push_back({written, begin, false});
+        ranges.push_back({begin, end, true});
+        written = end;
+    };
+
+    if (sparse && data.size() >= SPARSE_MIN_RUN) {
+        size_t page =
+            (SPARSE_ALIGNMENT - offset % SPARSE_ALIGNMENT) % SPARSE_ALIGNMENT;
+        size_t run = page;
+        for (; page + SPARSE_ALIGNMENT <= data.size();
+             page += SPARSE_ALIGNMENT) {
+            if (!all_zero(data.data() + page, SPARSE_ALIGNMENT)) {
+                end_run(run, page);
+                run = page + SPARSE_ALIGNMENT;
+            }
+        }
+        end_run(run, page);
+    }
+    if (written < data.size())
+        ranges.push_back({written, data.size(), false});
+}
+
+#if defined(_WIN32)
+
+// ntfs only leaves holes in files marked sparse and reserves space on its
+// own terms, files are written as they come
+struct BlockingFile {
+    std::ofstream out;
+    fs::path path;
+};
+
+#else
+
+struct BlockingFile {
+    int fd = -1;
+    bool ok = true;
+    /// where the next block goes
+    uint64_t offset = 0;
+    bool preallocated = false;
+    /// the file ends in a hole, which only the final size covers
+    bool ends_in_hole = false;
+};
+
+#endif
+
+#if defined(__linux__)
+
+// reserves the whole file, false only when the space is not there, a
+// filesystem that cannot preallocate gets the file written as usual
+static bool preallocate(int fd, uint64_t size, bool& preallocated) {
+    if (fallocate(fd, 0, 0, static_cast<off_t>(size)) == 0) {
+        preallocated = true;
+        return true;
+    }
+    return errno != ENOSPC && errno != EDQUOT;
+}
+
+#endif
+
+#if defined(KONDUIT_IO_URING)
+
+// the ring is driven through the raw syscalls, the few operations needed do
+// not warrant a liburing dependency
+
+static int io_uring_setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(
+    int fd,
+    unsigned to_submit,
+    unsigned min_complete,
+    unsigned flags
+) {
+    return static_cast<int>(syscall(
+        __NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0
+    ));
+}
+
+static int
+io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_register, fd, opcode, arg, nr_args)
+    );
+}
+
+/// sqes are handed to the kernel once this many are queued, or earlier when
+/// the writer has to wait
+constexpr unsigned SUBMIT_BATCH = 8;
+/// kernels cap rings at 32768 entries, far more than needed
+constexpr uint32_t MAX_QUEUE_DEPTH = 4096;
+
+struct Ring {
+    int fd = -1;
+    void* sq_map = MAP_FAILED;
+    size_t sq_map_size = 0;
+    void* cq_map = MAP_FAILED;
+    size_t cq_map_size = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size = 0;
+
+    unsigned* sq_tail = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    /// next sqe to fill in and how many were not handed to the kernel yet
+    unsigned sqe_tail = 0;
+    unsigned unsubmitted = 0;
+
+    Ring() = default;
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    ~Ring() {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqes_size);
+        if (cq_map != MAP_FAILED && cq_map != sq_map)
+            munmap(cq_map, cq_map_size);
+        if (sq_map != MAP_FAILED)
+            munmap(sq_map, sq_map_size);
+        if (fd >= 0)
+            close(fd);
+    }
+};
+
+template <typename T>
+static T* ring_field(void* map, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(map) + offset);
+}
+
+// every operation the writer uses has to be there, they came with 5.6
+static bool ring_supports_writes(int fd) {
+    constexpr unsigned PROBE_OPS = 256;
+    std::vector<io_uring_probe_op> buffer(
+        PROBE_OPS + sizeof(io_uring_probe) / sizeof(io_uring_probe_op) + 1
+    );
+    auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+    if (io_uring_register(fd, IORING_REGISTER_PROBE, probe, PROBE_OPS) < 0)
+        return false;
+    for (uint8_t op : {
+             IORING_OP_OPENAT,
+             IORING_OP_FALLOCATE,
+             IORING_OP_WRITE,
+             IORING_OP_FSYNC,
+             IORING_OP_CLOSE,
+         }) {
+        if (op > probe->last_op ||
+            !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ring_setup(Ring& ring, unsigned entries) {
+    io_uring_params params{};
+    ring.fd = io_uring_setup(entries, &params);
+    if (ring.fd < 0)
+        return false;
+    // without NODROP a full completion queue loses completions
+    if (!(params.features & IORING_FEAT_NODROP) ||
+        !ring_supports_writes(ring.fd)) {
+        return false;
+    }
+
+    ring.sq_map_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cq_map_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_map) {
+        ring.sq_map_size = ring.cq_map_size =
+            std::max(ring.sq_map_size, ring.cq_map_size);
+    }
+
+    ring.sq_map = mmap(
+        nullptr,
+        ring.sq_map_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ring.fd,
+        IORING_OFF_SQ_RING
+    );
+    if (ring.sq_map == MAP_FAILED)
+        return false;
+    ring.cq_map = single_map ? ring.sq_map
+                             : mmap(
+                                   nullptr,
+                                   ring.cq_map_size,
+                                   PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_POPULATE,
+                                   ring.fd,
+                                   IORING_OFF_CQ_RING
+                               );
+    if (ring.cq_map == MAP_FAILED)
+        return false;
+    ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    ring.sqes = static_cast<io_uring_sqe*>(mmap(
+        nullptr,
+        ring.sqes_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ring.fd,
+        IORING_OFF_SQES
+    ));
+    if (ring.sqes == MAP_FAILED)
+        return false;
+
+    ring.sq_tail = ring_field<unsigned>(ring.sq_map, params.sq_off.tail);
+    ring.sq_mask = *ring_field<unsigned>(ring.sq_map, params.sq_off.ring_mask);
+    ring.sq_entries = params.sq_entries;
+    ring.cq_head = ring_field<unsigned>(ring.cq_map, params.cq_off.head);
+    ring.cq_tail = ring_field<unsigned>(ring.cq_map, params.cq_off.tail);
+    ring.cq_mask = *ring_field<unsigned>(ring.cq_map, params.cq_off.ring_mask);
+    ring.cqes = ring_field<io_uring_cqe>(ring.cq_map, params.cq_off.cqes);
+
+    // sqes are used in ring order, so the indirection array stays the
+    // identity
+    auto* array = ring_field<unsigned>(ring.sq_map, params.sq_off.array);
+    for (unsigned i = 0; i < ring.sq_entries; ++i) {
+        array[i] = i;
+    }
+    ring.sqe_tail = *ring.sq_tail;
+    return true;
+}
+
+enum class UringOpKind : uint8_t {
+    OPEN,
+    PREALLOCATE,
+    WRITE,
+    PUNCH,
+    FSYNC,
+    CLOSE,
+};
+
+/// one slot per operation in flight, its index is the sqe's user_data
+struct UringOp {
+    UringOpKind kind;
+    size_t file;
+    /// the block a write takes its bytes from, shared by the writes of one
+    /// block when holes split it
+    std::shared_ptr<const std::vector<uint8_t>> block;
+    /// offset into `block` of the next byte to write
+    size_t begin;
+    /// file range still to write or punch, short writes continue from there
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct UringFile {
+    /// read by the kernel when the open is submitted
+    std::string path;
+    /// preallocated up front when at least PREALLOCATE_MIN_SIZE
+    uint64_t size = 0;
+    int fd = -1;
+    /// set once the file is open and preallocated, writes wait until then
+    bool opened = false;
+    bool preallocated = false;
+    bool closing = false;
+    bool sized = false;
+    bool synced = false;
+    bool close_submitted = false;
+    bool ok = true;
+    /// where the next block goes, writes of a file may complete in any order
+    uint64_t offset = 0;
+    bool ends_in_hole = false;
+    /// writes, punches and the fsync, the close waits for them
+    uint32_t in_flight = 0;
+    /// writes and punches that arrived before the file was opened
+    std::deque<UringOp> waiting;
+};
+
+struct UringWriter {
+    std::vector<UringOp> ops;
+    std::vector<uint32_t> free_ops;
+    std::unordered_map<size_t, UringFile> files;
+    uint32_t depth = 0;
+    /// operations in flight plus writes waiting for their file to open, a
+    /// completion never raises it so only new calls have to wait
+    uint32_t pending = 0;
+    FileWriterOptions options;
+    std::vector<BlockRange> ranges;
+    /// declared last so the ring is torn down before the buffers it may
+    /// still read from
+    Ring ring;
+};
+
+static std::unique_ptr<UringWriter>
+uring_create(const FileWriterOptions& options) {
+    auto writer = std::make_unique<UringWriter>();
+    uint32_t queue_depth =
+        std::clamp<uint32_t>(options.queue_depth, 1, MAX_QUEUE_DEPTH);
+    if (!ring_setup(writer->ring, queue_depth))
+        return nullptr;
+    // the completion queue is twice the submission queue, neither can fill
+    // up when no more than sq_entries operations are pending
+    writer->depth = std::min(queue_depth, writer->ring.sq_entries);
+    writer->ops.resize(writer->depth);
+    for (uint32_t slot = writer->depth; slot-- > 0;) {
+        writer->free_ops.push_back(slot);
+    }
+    writer->options = options;
+    return writer;
+}
+
+static io_uring_sqe* next_sqe(Ring& ring, uint32_t slot) {
+    auto* sqe = &ring.sqes[ring.sqe_tail & ring.sq_mask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = slot;
+    ring.sqe_tail++;
+    ring.unsubmitted++;
+    return sqe;
+}
+
+static uint32_t take_op(UringWriter& writer, UringOpKind kind, size_t file) {
+    uint32_t slot = writer.free_ops.back();
+    writer.free_ops.pop_back();
+    writer.ops[slot] = {kind, file, nullptr, 0, 0, 0};
+    writer.pending++;
+    return slot;
+}
+
+static void release_op(UringWriter& writer, uint32_t slot) {
+    writer.ops[slot].block = nullptr;
+    writer.free_ops.push_back(slot);
+    writer.pending--;
+}
+
+static void prep_range(UringWriter& writer, uint32_t slot, int fd) {
+    const auto& op = writer.ops[slot];
+    auto* sqe = next_sqe(writer.ring, slot);
+    sqe->fd = fd;
+    sqe->off = op.offset;
+    if (op.kind == UringOpKind::PUNCH) {
+        sqe->opcode = IORING_OP_FALLOCATE;
+        sqe->addr = op.length;
+        sqe->len = FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+    } else {
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->addr = reinterpret_cast<uint64_t>(op.block->data() + op.begin);
+        sqe->len = static_cast<uint32_t>(op.length);
+    }
+}
+
+// a punch only makes a hole where the file was preallocated, anywhere else
+// the skipped range already is one
+static void submit_range(UringWriter& writer, UringFile& file, UringOp range) {
+    if (!file.ok ||
+        (range.kind == UringOpKind::PUNCH && !file.preallocated)) {
+        return;
+    }
+    uint32_t slot = take_op(writer, range.kind, range.file);
+    writer.ops[slot] = std::move(range);
+    file.in_flight++;
+    prep_range(writer, slot, file.fd);
+}
+
+static void
+uring_file_ready(UringWriter& writer, UringFile& file, bool ok) {
+    file.opened = true;
+    file.ok = file.ok && ok;
+    while (!file.waiting.empty()) {
+        auto range = std::move(file.waiting.front());
+        file.waiting.pop_front();
+        writer.pending--;
+        submit_range(writer, file, std::move(range));
+    }
+}
+
+// queues the fsync and then the close once the last write completed, a file
+// whose open failed is reported right away
+static void uring_try_finish(
+    UringWriter& writer,
+    size_t id,
+    UringFile& file,
+    const FileFinished& finished
+) {
+    if (!file.closing || !file.opened || file.in_flight > 0 ||
+        file.close_submitted) {
+        return;
+    }
+    if (file.fd < 0) {
+        writer.files.erase(id);
+        finished(id, false);
+        return;
+    }
+    // a hole at the end and preallocation both leave the size to be set,
+    // there is no io_uring truncate before linux 6.9
+    if (!file.sized) {
+        file.sized = true;
+        if (file.ok && (file.ends_in_hole || file.preallocated) &&
+            ftruncate(file.fd, static_cast<off_t>(file.offset)) != 0) {
+            file.ok = false;
+        }
+    }
+    if (file.ok && writer.options.sync && !file.synced) {
+        file.synced = true;
+        file.in_flight++;
+        auto* sqe =
+            next_sqe(writer.ring, take_op(writer, UringOpKind::FSYNC, id));
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = file.fd;
+        // the size counts as data, only timestamps are left out
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        return;
+    }
+    file.close_submitted = true;
+    auto* sqe = next_sqe(writer.ring, take_op(writer, UringOpKind::CLOSE, id));
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = file.fd;
+}
+
+static void uring_complete(
+    UringWriter& writer,
+    uint32_t slot,
+    int32_t res,
+    const FileFinished& finished
+) {
+    auto& op = writer.ops[slot];
+    size_t id = op.file;
+    auto& file = writer.files.at(id);
+
+    switch (op.kind) {
+        case UringOpKind::OPEN:
+            release_op(writer, slot);
+            if (res < 0) {
+                uring_file_ready(writer, file, false);
+                break;
+            }
+            file.fd = res;
+            if (writer.options.preallocate &&
+                file.size >= PREALLOCATE_MIN_SIZE) {
+                auto* sqe = next_sqe(
+                    writer.ring,
+                    take_op(writer, UringOpKind::PREALLOCATE, id)
+                );
+                sqe->opcode = IORING_OP_FALLOCATE;
+                sqe->fd = file.fd;
+                sqe->addr = file.size;
+                return;
+            }
+            uring_file_ready(writer, file, true);
+            break;
+        case UringOpKind::PREALLOCATE:
+            release_op(writer, slot);
+            // the file fails right away when the space is not there, a
+            // filesystem that cannot preallocate gets it written as usual
+            file.preallocated = res == 0;
+            uring_file_ready(writer, file, res != -ENOSPC && res != -EDQUOT);
+            break;
+        case UringOpKind::WRITE:
+            if (res > 0 && static_cast<uint64_t>(res) < op.length) {
+                op.begin += static_cast<size_t>(res);
+                op.offset += static_cast<uint64_t>(res);
+                op.length -= static_cast<uint64_t>(res);
+                prep_range(writer, slot, file.fd);
+                return;
+            }
+            // a write of 0 bytes means the device is full
+            if (res <= 0)
+                file.ok = false;
+            release_op(writer, slot);
+            file.in_flight--;
+            break;
+        case UringOpKind::PUNCH:
+            // the range stays allocated and reads back as zeros
+            release_op(writer, slot);
+            file.in_flight--;
+            break;
+        case UringOpKind::FSYNC:
+            if (res < 0)
+                file.ok = false;
+            release_op(writer, slot);
+            file.in_flight--;
+            break;
+        case UringOpKind::CLOSE: {
+            release_op(writer, slot);
+            bool ok = file.ok && res >= 0;
+            writer.files.erase(id);
+            finished(id, ok);
+            return;
+        }
+    }
+    uring_try_finish(writer, id, file, finished);
+}
+
+static void uring_reap(UringWriter& writer, const FileFinished& finished) {
+    auto& ring = writer.ring;
+    unsigned head =
+        std::atomic_ref(*ring.cq_head).load(std::memory_order_relaxed);
+    unsigned tail =
+        std::atomic_ref(*ring.cq_tail).load(std::memory_order_acquire);
+    while (head != tail) {
+        io_uring_cqe cqe = ring.cqes[head & ring.cq_mask];
+        ++head;
+        std::atomic_ref(*ring.cq_head).store(head, std::memory_order_release);
+        uring_complete(
+            writer, static_cast<uint32_t>(cqe.user_data), cqe.res, finished
+        );
+    }
+}
+
+// hands the queued sqes to the kernel and handles what completed, waiting for
+// at least `min_complete` completions, false once the ring is unusable
+static bool uring_enter(
+    UringWriter& writer,
+    unsigned min_complete,
+    const FileFinished& finished
+) {
+    auto& ring = writer.ring;
+    std::atomic_ref(*ring.sq_tail).store(
+        ring.sqe_tail, std::memory_order_release
+    );
+    for (;;) {
+        int submitted = io_uring_enter(
+            ring.fd,
+            ring.unsubmitted,
+            min_complete,
+            min_complete > 0 ? IORING_ENTER_GETEVENTS : 0
+        );
+        if (submitted >= 0) {
+            ring.unsubmitted -= static_cast<unsigned>(submitted);
+            break;
+        }
+        if (errno == EINTR)
+            continue;
+        // the kernel is short on memory or completions are backed up, both
+        // pass once completions are handled
+        if (errno == EAGAIN || errno == EBUSY) {
+            uring_reap(writer, finished);
+            std::this_thread::yield();
+            continue;
+        }
+        return false;
+    }
+    uring_reap(writer, finished);
+    return true;
+}
+
+// the ring failed in a way it does not recover from, its files are reported
+// as failed and later ones go through the blocking writer
+static void uring_abandon(UringWriter& writer, const FileFinished& finished) {
+    auto files = std::move(writer.files);
+    writer.files.clear();
+    for (auto& [id, file] : files) {
+        if (file.fd >= 0 && !file.close_submitted)
+            close(file.fd);
+        finished(id, false);
+    }
+}
+
+#else
+
+struct UringWriter {};
+
+#endif
+
+struct FileWriterState {
+    FileFinished finished;
+    FileWriterOptions options;
+    std::unordered_map<size_t, BlockingFile> files;
+    std::vector<BlockRange> ranges;
+    std::unique_ptr<UringWriter> uring;
+};
+
+bool write_backend_available(WriteBackend backend) {
+    if (backend != WriteBackend::IO_URING)
+        return true;
+#if defined(KONDUIT_IO_URING)
+    static const bool available = [] {
+        Ring ring;
+        return ring_setup(ring, 4);
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+WriteBackend resolve_write_backend(WriteBackend backend) {
+    if (backend == WriteBackend::AUTO) {
+        return write_backend_available(WriteBackend::IO_URING)
+                   ? WriteBackend::IO_URING
+                   : WriteBackend::THREADS;
+    }
+    return write_backend_available(backend) ? backend : WriteBackend::THREADS;
+}
+
+FileWriter::FileWriter(const FileWriterOptions& options, FileFinished finished)
+    : backend(resolve_write_backend(options.backend)),
+      state(std::make_unique<FileWriterState>()) {
+    state->finished = std::move(finished);
+    state->options = options;
+#if defined(KONDUIT_IO_URING)
+    if (backend == WriteBackend::IO_URING) {
+        state->uring = uring_create(options);
+        if (!state->uring)
+            backend = WriteBackend::THREADS;
+    }
+#endif
+}
+
+FileWriter::~FileWriter() {
+    file_writer_drain(*this);
+}
+
+#if defined(_WIN32)
+
+static void blocking_open(
+    FileWriterState&,
+    BlockingFile& file,
+    const fs::path& path,
+    uint64_t
+) {
+    file.path = path;
+    file.out.open(path, std::ios::binary | std::ios::trunc);
+}
+
+static void blocking_write(
+    FileWriterState&,
+    BlockingFile& file,
+    const std::vector<uint8_t>& data
+) {
+    if (file.out) {
+        file.out.write(
+            reinterpret_cast<const char*>(data.data()),
+            static_cast<std::streamsize>(data.size())
+        );
+    }
+}
+
+static bool blocking_close(FileWriterState& state, BlockingFile& file) {
+    file.out.close();
+    bool ok = !file.out.fail();
+    if (ok && state.options.sync)
+        ok = sync_file(file.path);
+    return ok;
+}
+
+#else
+
+static void blocking_open(
+    FileWriterState& state,
+    BlockingFile& file,
+    const fs::path& path,
+    uint64_t size
+) {
+    file.fd =
+        open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    file.ok = file.fd >= 0;
+#if defined(__linux__)
+    if (file.ok && state.options.preallocate && size >= PREALLOCATE_MIN_SIZE)
+        file.ok = preallocate(file.fd, size, file.preallocated);
+#else
+    (void)state;
+    (void)size;
+#endif
+}
+
+static bool write_all(int fd, const uint8_t* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, offset);
+        if (written < 0 && errno == EINTR)
+            continue;
+        // a write of 0 bytes means the device is full
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += written;
+    }
+    return true;
+}
+
+static void blocking_write(
+    FileWriterState& state,
+    BlockingFile& file,
+    const std::vector<uint8_t>& data
+) {
+    if (!file.ok)
+        return;
+    split_block(data, file.offset, state.options.sparse, state.ranges);
+    for (const auto& range : state.ranges) {
+        auto offset = static_cast<off_t>(file.offset + range.begin);
+        size_t length = range.end - range.begin;
+        if (!range.hole) {
+            file.ok = file.ok && write_all(
+                                     file.fd,
+                                     data.data() + range.begin,
+                                     length,
+                                     offset
+                                 );
+        }
+#if defined(__linux__)
+        // the range stays allocated and reads back as zeros when this fails
+        else if (file.preallocated) {
+            fallocate(
+                file.fd,
+                FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                offset,
+                static_cast<off_t>(length)
+            );
+        }
+#endif
+    }
+    file.offset += data.size();
+    file.ends_in_hole = state.ranges.back().hole;
+}
+
+static bool blocking_close(FileWriterState& state, BlockingFile& file) {
+    bool ok = file.ok;
+    // a hole at the end and preallocation both leave the size to be set
+    if (ok && (file.ends_in_hole || file.preallocated))
+        ok = ftruncate(file.fd, static_cast<off_t>(file.offset)) == 0;
+    if (ok && state.options.sync)
+        ok = fsync(file.fd) == 0;
+    if (file.fd >= 0 && close(file.fd) != 0)
+        ok = false;
+    return ok;
+}
+
+#endif
+
+#if defined(KONDUIT_IO_URING)
+
+static void uring_failed(FileWriter& writer) {
+    uring_abandon(*writer.state->uring, writer.state->finished);
+    writer.backend = WriteBackend::THREADS;
+}
+
+// keeps the pending operations within the queue depth
+static bool uring_reserve(FileWriter& writer) {
+    auto& uring = *writer.state->uring;
+    while (uring.pending >= uring.depth) {
+        if (!uring_enter(uring, 1, writer.state->finished)) {
+            uring_failed(writer);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void uring_submit_batch(FileWriter& writer) {
+    auto& uring = *writer.state->uring;
+    if (uring.ring.unsubmitted >= SUBMIT_BATCH &&
+        !uring_enter(uring, 0, writer.state->finished)) {
+        uring_failed(writer);
+    }
+}
+
+#endif
+
+void file_writer_open(
+    FileWriter& writer,
+    size_t file,
+    const fs::path& path,
+    uint64_t size
+) {
+#if defined(KONDUIT_IO_URING)
+    if (writer.backend == WriteBackend::IO_URING && uring_reserve(writer)) {
+        auto& uring = *writer.state->uring;
+        auto [it, inserted] = uring.files.try_emplace(file);
+        if (!inserted)
+            return;
+        it->second.path = path.native();
+        it->second.size = size;
+        auto* sqe =
+            next_sqe(uring.ring, take_op(uring, UringOpKind::OPEN, file));
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(it->second.path.c_str());
+        sqe->len = 0666;
+        sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        uring_submit_batch(writer);
+        return;
+    }
+#endif
+    auto [it, inserted] = writer.state->files.try_emplace(file);
+    if (inserted)
+        blocking_open(*writer.state, it->second, path, size);
+}
+
+void file_writer_write(
+    FileWriter& writer,
+    size_t file,
+    std::vector<uint8_t> data
+) {
+    if (data.empty())
+        return;
+#if defined(KONDUIT_IO_URING)
+    if (writer.backend == WriteBackend::IO_URING) {
+        auto& uring = *writer.state->uring;
+        auto it = uring.files.find(file);
+        if (it == uring.files.end() || !it->second.ok)
+            return;
+        auto& target = it->second;
+        auto block = std::make_shared<const std::vector<uint8_t>>(
+            std::move(data)
+        );
+        auto& ranges = uring.ranges;
+        split_block(*block, target.offset, uring.options.sparse, ranges);
+        uint64_t offset = target.offset;
+        target.offset += block->size();
+        target.ends_in_hole = ranges.back().hole;
+
+        // every range is an operation of its own, a file whose open is still
+        // in flight holds on to them
+        for (const auto& range : ranges) {
+            if (!uring_reserve(writer))
+                return;
+            UringOp op{
+                range.hole ? UringOpKind::PUNCH : UringOpKind::WRITE,
+                file,
+                range.hole ? nullptr : block,
+                range.begin,
+                offset + range.begin,
+                range.end - range.begin,
+            };
+            if (!target.opened) {
+                target.waiting.push_back(std::move(op));
+                uring.pending++;
+            } else {
+                submit_range(uring, target, std::move(op));
+            }
+        }
+        uring_submit_batch(writer);
+        return;
+    }
+#endif
+    auto it = writer.state->files.find(file);
+    if (it != writer.state->files.end())
+        blocking_write(*writer.state, it->second, data);
+}
+
+void file_writer_close(FileWriter& writer, size_t file, bool ok) {
+#if defined(KONDUIT_IO_URING)
+    if (writer.backend == WriteBackend::IO_URING && uring_reserve(writer)) {
+        auto& uring = *writer.state->uring;
+        auto it = uring.files.find(file);
+        if (it == uring.files.end() || it->second.closing)
+            return;
+        it->second.closing = true;
+        it->second.ok = it->second.ok && ok;
+        uring_try_finish(uring, file, it->second, writer.state->finished);
+        uring_submit_batch(writer);
+        return;
+    }
+#endif
+    auto it = writer.state->files.find(file);
+    if (it == writer.state->files.end())
+        return;
+    ok = blocking_close(*writer.state, it->second) && ok;
+    writer.state->files.erase(it);
+    writer.state->finished(file, ok);
+}
+
+void file_writer_submit(FileWriter& writer) {
+#if defined(KONDUIT_IO_URING)
+    if (writer.backend != WriteBackend::IO_URING)
+        return;
+    auto& uring = *writer.state->uring;
+    // completions may queue the next operations of their file
+    do {
+        if (!uring_enter(uring, 0, writer.state->finished)) {
+            uring_failed(writer);
+            return;
+        }
+    } while (uring.ring.unsubmitted > 0);
+#endif
+}
+
+void file_writer_drain(FileWriter& writer) {
+#if defined(KONDUIT_IO_URING)
+    if (writer.backend == WriteBackend::IO_URING) {
+        auto& uring = *writer.state->uring;
+        std::vector<size_t> unclosed;
+        for (const auto& [id, file] : uring.files) {
+            if (!file.closing)
+                unclosed.push_back(id);
+        }
+        for (size_t id : unclosed) {
+            file_writer_close(writer, id, false);
+        }
+        while (writer.backend == WriteBackend::IO_URING &&
+               !uring.files.empty()) {
+            if (!uring_enter(uring, 1, writer.state->finished))
+                uring_failed(writer);
+        }
+    }
+#endif
+    while (!writer.state->files.empty()) {
+        file_writer_close(writer, writer.state->files.begin()->first, false);
+    }
+}
+
+#if defined(_WIN32)
+
+// ofstream has no way to flush to the device, the file is opened once more
+// for it, which syncs the same inode
+bool sync_file(const fs::path& path) {
+    HANDLE file = CreateFileW(
+        path.c_str(),
+        GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    bool ok = FlushFileBuffers(file);
+    CloseHandle(file);
+    return ok;
+}
+
+// ntfs journals its directory changes, a directory can only be flushed
+// with backup privileges
+bool sync_directory(const fs::path&) {
+    return true;
+}
+
+bool sync_filesystem(const fs::path&) {
+    return false;
+}
+
+#else
+
+static bool sync_path(const fs::path& path, int flags) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | flags);
+    if (fd < 0)
+        return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+bool sync_file(const fs::path& path) {
+    return sync_path(path, 0);
+}
+
+bool sync_directory(const fs::path& path) {
+    return sync_path(path, O_DIRECTORY);
+}
+
+bool sync_filesystem(const fs::path& path) {
+#if defined(__linux__)
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+    if (fd < 0)
+        return false;
+    bool ok = syncfs(fd) == 0;
+    close(fd);
+    return ok;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+#endif
+
+}  // namespace encoding
@@ -0,0 +1,119 @@
+#ifndef KONDUIT_INSTALLER_FILE_WRITER_HPP
+#define KONDUIT_INSTALLER_FILE_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace encoding {
+
+enum class WriteBackend : uint8_t {
+    /// io_uring where the kernel allows it, blocking writes otherwise
+    AUTO,
+    /// batches the opens, writes, fsyncs and closes of many files into few
+    /// syscalls, linux 5.6 and later
+    IO_URING,
+    /// one blocking write after the other on the calling thread, the
+    /// pipeline runs several of these writer threads side by side
+    THREADS,
+};
+
+/// files of at least this size get their whole size reserved when they are
+/// opened, so a full disk fails them right away instead of halfway through
+/// and the filesystem can place them in one piece
+constexpr uint64_t PREALLOCATE_MIN_SIZE = 1024 * 1024;
+/// zero runs shorter than this are written out, smaller holes only fragment
+/// the file
+constexpr size_t SPARSE_MIN_RUN = 64 * 1024;
+/// holes start and end on this boundary of the file
+constexpr size_t SPARSE_ALIGNMENT = 4096;
+
+const char* write_backend_name(WriteBackend backend);
+
+/// false for io_uring on other platforms, older kernels and where seccomp
+/// or the io_uring_disabled sysctl forbid it
+bool write_backend_available(WriteBackend backend);
+
+/// the backend `backend` ends up as, AUTO resolves to io_uring or threads
+WriteBackend resolve_write_backend(WriteBackend backend);
+
+struct FileWriterOptions {
+    WriteBackend backend = WriteBackend::AUTO;
+    /// operations an io_uring writer keeps in flight, blocks waiting for
+    /// their file to open included, bounds the memory it holds on to
+    uint32_t queue_depth = 64;
+    /// fsync every file before it is closed
+    bool sync = false;
+    /// reserve the size of large files up front, see PREALLOCATE_MIN_SIZE,
+    /// linux only
+    bool preallocate = true;
+    /// leave runs of zeros as holes instead of writing them, windows writes
+    /// them out
+    bool sparse = true;
+};
+
+/// called once per file after it was closed, `ok` is false when it failed to
+/// open or write or was closed as failed, the file is left on disk
+using FileFinished = std::function<void(size_t file, bool ok)>;
+
+struct FileWriterState;
+
+/// writes many files at once for one thread, files are named by the
+/// caller's own ids and finish in any order
+struct FileWriter {
+    /// resolved backend, io_uring falls back to threads when the ring cannot
+    /// be set up
+    WriteBackend backend;
+    std::unique_ptr<FileWriterState> state;
+
+    FileWriter(const FileWriterOptions& options, FileFinished finished);
+    ~FileWriter();
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+};
+
+/// creates or truncates `path`, the blocks written to `file` go there,
+/// `size` is what the file is expected to end up as
+void file_writer_open(
+    FileWriter& writer,
+    size_t file,
+    const std::filesystem::path& path,
+    uint64_t size
+);
+
+/// appends `data` to `file`, dropped once the file failed
+void file_writer_write(
+    FileWriter& writer,
+    size_t file,
+    std::vector<uint8_t> data
+);
+
+/// no more blocks follow, `finished` is called once everything of the file
+/// is on disk, `ok` false only closes it and reports it as failed
+void file_writer_close(FileWriter& writer, size_t file, bool ok);
+
+/// hands everything queued so far to the kernel without waiting on it, for
+/// before the calling thread goes to sleep
+void file_writer_submit(FileWriter& writer);
+
+/// waits until every file was reported, files that were never closed are
+/// closed as failed
+void file_writer_drain(FileWriter& writer);
+
+/// flushes a closed file to the device
+bool sync_file(const std::filesystem::path& path);
+
+/// makes the entries created, renamed or removed in the directory `path`
+/// durable, always true on windows, where ntfs journals them itself
+bool sync_directory(const std::filesystem::path& path);
+
+/// flushes everything written to the filesystem holding `path` with one
+/// syncfs, linux only, false elsewhere or when it failed
+bool sync_filesystem(const std::filesystem::path& path);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_FILE_WRITER_HPP
@@ -0,0 +1,145 @@
+#include "install_job.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace encoding {
+
+InstallJob::~InstallJob() {
+    if (thread.joinable()) {
+        progress.cancelled = true;
+        thread.join();
+    }
+}
+
+static void add_stage(StageStats& into, const StageStats& from) {
+    into.threads = std::max(into.threads, from.threads);
+    into.bytes += from.bytes;
+    into.busy_seconds += from.busy_seconds;
+    into.wait_seconds += from.wait_seconds;
+}
+
+static void add_result(PipelineResult& into, PipelineResult&& from) {
+    auto& extract = into.extract;
+    extract.files_written += from.extract.files_written;
+    extract.directories_created += from.extract.directories_created;
+    extract.files_unchanged += from.extract.files_unchanged;
+    extract.files_removed += from.extract.files_removed;
+    extract.files_linked += from.extract.files_linked;
+    extract.bytes_written += from.extract.bytes_written;
+    std::ranges::move(from.extract.failed, std::back_inserter(extract.failed));
+    add_stage(into.decode, from.decode);
+    add_stage(into.write, from.write);
+    if (from.verify) {
+        auto& verify = into.verify ? *into.verify : into.verify.emplace();
+        std::ranges::move(
+            from.verify->failed, std::back_inserter(verify.failed)
+        );
+        verify.bytes += from.verify->bytes;
+        verify.threads = std::max(verify.threads, from.verify->threads);
+        verify.seconds += from.verify->seconds;
+        verify.cancelled |= from.verify->cancelled;
+    }
+    into.wall_seconds += from.wall_seconds;
+    into.cancelled |= from.cancelled;
+}
+
+static InstallState run_components(InstallJob& job, PipelineOptions options) {
+    PipelineResult total;
+    InstallState state = InstallState::DONE;
+    for (uint32_t i = 0; i < job.components.size(); ++i) {
+        auto& component = job.components[i];
+        // the counters describe the component being installed
+        job.progress.bytes_done = 0;
+        job.progress.bytes_total = 0;
+        job.progress.files_done = 0;
+        job.progress.files_total = 0;
+        job.progress.current_entry = UINT32_MAX;
+        job.progress.verifying = false;
+        job.current_component.store(i, std::memory_order_release);
+
+        options.component = component.name;
+        options.digests = component.digests ? &*component.digests : nullptr;
+        auto result = install_pipelined(
+            component.reader.get(), job.install_path, options
+        );
+        if (!result) {
+            state = InstallState::FAILED;
+            break;
+        }
+        bool cancelled = result->cancelled;
+        bool failed = !result->extract.failed.empty();
+        add_result(total, std::move(*result));
+        if (cancelled) {
+            state = InstallState::CANCELLED;
+            break;
+        }
+        if (failed) {
+            state = InstallState::FAILED;
+            break;
+        }
+    }
+    job.result = std::move(total);
+    return state;
+}
+
+std::unique_ptr<InstallJob> install_start(
+    std::vector<InstallComponent> components,
+    const std::filesystem::path& install_path,
+    PipelineOptions options
+) {
+    if (components.empty() || std::ranges::any_of(components, [](auto& c) {
+            return !c.reader;
+        })) {
+        error("Invalid ZIP reader");
+        return nullptr;
+    }
+
+    auto job = std::make_unique<InstallJob>();
+    job->components = std::move(components);
+    job->install_path = install_path;
+    options.progress = &job->progress;
+
+    // the job is heap allocated and joins in its destructor, so the worker
+    // can hold on to it for its whole lifetime
+    job->thread = std::thread([job = job.get(), options] {
+        auto state = run_components(*job, options);
+        // the result is published before the state so a reader seeing the
+        // final state also sees it
+        job->state.store(state, std::memory_order_release);
+    });
+    return job;
+}
+
+void install_cancel(InstallJob& job) {
+    job.progress.cancelled = true;
+}
+
+bool install_running(const InstallJob& job) {
+    return job.state.load(std::memory_order_acquire) == InstallState::RUNNING;
+}
+
+float install_fraction(const InstallJob& job) {
+    uint64_t total = job.progress.bytes_total;
+    if (total == 0)
+        return install_running(job) ? 0.0f : 1.0f;
+    return static_cast<float>(
+        static_cast<double>(job.progress.bytes_done) / total
+    );
+}
+
+std::string_view install_current_entry(const InstallJob& job) {
+    const auto& component = job.components[job.current_component.load(
+        std::memory_order_acquire
+    )];
+    auto entry =
+        zip_get_entry(component.reader.get(), job.progress.current_entry);
+    return entry ? entry->name : std::string_view{};
+}
+
+std::string_view install_current_component(const InstallJob& job) {
+    return job.components[job.current_component.load(std::memory_order_acquire)]
+        .name;
+}
+
+}  // namespace encoding
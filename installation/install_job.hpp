@@ -0,0 +1,81 @@
+#ifndef KONDUIT_INSTALLER_INSTALL_JOB_HPP
+#define KONDUIT_INSTALLER_INSTALL_JOB_HPP
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "install_pipeline.hpp"
+
+namespace encoding {
+
+enum class InstallState {
+    RUNNING,
+    DONE,
+    FAILED,
+    CANCELLED,
+};
+
+/// one selected bundle, components that were not selected never get a
+/// reader so their bundles are not even scanned
+struct InstallComponent {
+    std::string name{CORE_COMPONENT};
+    /// shared with the ui, which keeps it to size the next install, the
+    /// install only reads from it
+    std::shared_ptr<ZipReader> reader;
+    /// the installed files are verified against them when present
+    std::optional<DigestManifest> digests;
+};
+
+/// an install running on a background thread, the ui polls `progress` and
+/// `state` every frame and never blocks on it
+///
+/// components are installed one after the other, `progress` restarts for
+/// every one of them
+struct InstallJob {
+    InstallProgress progress;
+    std::atomic<InstallState> state{InstallState::RUNNING};
+    /// summed over all components, only valid once `state` left RUNNING
+    std::optional<PipelineResult> result;
+    std::vector<InstallComponent> components;
+    /// index into `components` of the one being installed
+    std::atomic<uint32_t> current_component{0};
+    std::filesystem::path install_path;
+    std::thread thread;
+
+    InstallJob() = default;
+    /// cancels the install if it is still running and waits for it
+    ~InstallJob();
+    InstallJob(const InstallJob&) = delete;
+    InstallJob& operator=(const InstallJob&) = delete;
+};
+
+/// starts installing every component in order under `install_path`, the job
+/// takes ownership of their readers and digests, a failed or cancelled
+/// component stops the ones after it
+std::unique_ptr<InstallJob> install_start(
+    std::vector<InstallComponent> components,
+    const std::filesystem::path& install_path,
+    PipelineOptions options = {}
+);
+
+/// asks the job to stop, it ends up in CANCELLED once the workers noticed
+void install_cancel(InstallJob& job);
+
+bool install_running(const InstallJob& job);
+
+/// 0 to 1 by bytes written, restarts from 0 while verifying
+float install_fraction(const InstallJob& job);
+
+/// name of the entry being decoded, empty before the first one
+std::string_view install_current_entry(const InstallJob& job);
+
+std::string_view install_current_component(const InstallJob& job);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_INSTALL_JOB_HPP
@@ -0,0 +1,645 @@
+#include "install_pipeline.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_set>
+#include "transaction.hpp"
+
+namespace encoding {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double StageStats::throughput() const {
+    return busy_seconds > 0 ? static_cast<double>(bytes) / busy_seconds : 0;
+}
+
+/// decoded bytes of one file, `last` closes the file and `failed` discards it
+struct WriteBlock {
+    size_t job;
+    std::vector<uint8_t> data;
+    bool last;
+    bool failed;
+};
+
+/// single consumer queue that blocks producers once `capacity` blocks are
+/// waiting
+struct BlockQueue {
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<WriteBlock> blocks;
+    size_t capacity;
+    bool closed = false;
+
+    explicit BlockQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(WriteBlock block) {
+        std::unique_lock lock(mutex);
+        not_full.wait(lock, [&] { return blocks.size() < capacity; });
+        blocks.push_back(std::move(block));
+        not_empty.notify_one();
+    }
+
+    /// nullopt once the queue is closed and drained
+    std::optional<WriteBlock> pop() {
+        std::unique_lock lock(mutex);
+        not_empty.wait(lock, [&] { return !blocks.empty() || closed; });
+        if (blocks.empty())
+            return std::nullopt;
+        auto block = std::move(blocks.front());
+        blocks.pop_front();
+        not_full.notify_one();
+        return block;
+    }
+
+    /// nullopt when nothing is waiting right now
+    std::optional<WriteBlock> try_pop() {
+        std::lock_guard lock(mutex);
+        if (blocks.empty())
+            return std::nullopt;
+        auto block = std::move(blocks.front());
+        blocks.pop_front();
+        not_full.notify_one();
+        return block;
+    }
+
+    void close() {
+        std::lock_guard lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+};
+
+/// stats of one thread, merged into the stage once it is done
+struct ThreadStats {
+    uint64_t bytes = 0;
+    double busy = 0;
+    double wait = 0;
+};
+
+static void merge_stats(StageStats& stage, const ThreadStats& thread) {
+    stage.bytes += thread.bytes;
+    stage.busy_seconds += thread.busy;
+    stage.wait_seconds += thread.wait;
+}
+
+static void write_blocks(
+    BlockQueue& queue,
+    const std::vector<ExtractJob>& jobs,
+    std::atomic<uint32_t>& files_written,
+    std::vector<uint8_t>& completed,
+    std::vector<std::string>& failed,
+    std::mutex& failed_mutex,
+    const FileWriterOptions& writer_options,
+    InstallProgress* progress,
+    ThreadStats& stats
+) {
+    // files finish in the order their writes complete, not the one they were
+    // queued in
+    auto finished = [&](size_t job, bool ok) {
+        if (ok) {
+            files_written++;
+            completed[job] = 1;
+            if (progress)
+                progress->files_done++;
+            return;
+        }
+        std::error_code ec;
+        fs::remove(jobs[job].destination, ec);
+        error(std::format("Failed to extract {}", jobs[job].name).c_str());
+        std::lock_guard lock(failed_mutex);
+        failed.push_back(jobs[job].name);
+    };
+    FileWriter writer(writer_options, finished);
+    // a writer can hold a file open per decoder, blocks of different files
+    // interleave in its queue
+    std::unordered_set<size_t> open_files;
+
+    for (;;) {
+        auto block = queue.try_pop();
+        if (!block) {
+            // whatever is batched up goes to the kernel before the thread
+            // sleeps on the queue
+            auto start = Clock::now();
+            file_writer_submit(writer);
+            stats.busy += seconds_since(start);
+
+            auto waiting = Clock::now();
+            block = queue.pop();
+            stats.wait += seconds_since(waiting);
+            if (!block)
+                break;
+        }
+
+        auto start = Clock::now();
+        size_t job = block->job;
+        if (!open_files.contains(job)) {
+            // a file whose first block failed was never opened
+            if (block->failed) {
+                finished(job, false);
+                stats.busy += seconds_since(start);
+                continue;
+            }
+            if (jobs[job].replace) {
+                std::error_code ec;
+                fs::remove(jobs[job].destination, ec);
+            }
+            file_writer_open(
+                writer, job, jobs[job].destination, jobs[job].size
+            );
+            open_files.insert(job);
+        }
+
+        if (!block->failed && !block->data.empty()) {
+            stats.bytes += block->data.size();
+            if (progress)
+                progress->bytes_done += block->data.size();
+            file_writer_write(writer, job, std::move(block->data));
+        }
+        if (block->last) {
+            file_writer_close(writer, job, !block->failed);
+            open_files.erase(job);
+        }
+        stats.busy += seconds_since(start);
+    }
+
+    // only reachable when a decoder died without closing its file
+    for (size_t job : open_files) {
+        file_writer_close(writer, job, false);
+    }
+    auto start = Clock::now();
+    file_writer_drain(writer);
+    stats.busy += seconds_since(start);
+}
+
+static void decode_batches(
+    ZipReader* reader,
+    const ExtractPlan& plan,
+    std::atomic<size_t>& next,
+    std::vector<std::unique_ptr<BlockQueue>>& queues,
+    size_t block_size,
+    InstallProgress* progress,
+    ThreadStats& stats
+) {
+    Decoder decoder;
+    ChunkCache cache;
+    auto cancelled = [&] { return progress && progress->cancelled; };
+
+    for (size_t b = next++; b < plan.batches.size() && !cancelled();
+         b = next++) {
+        for (size_t i = plan.batches[b].begin;
+             i < plan.batches[b].end && !cancelled();
+             ++i) {
+            if (progress)
+                progress->current_entry = plan.jobs[i].index;
+
+            // a file sticks to one writer so its blocks stay in order
+            auto& queue = *queues[i % queues.size()];
+            auto start = Clock::now();
+            double waited = 0;
+
+            auto push = [&](WriteBlock block) {
+                auto waiting = Clock::now();
+                queue.push(std::move(block));
+                waited += seconds_since(waiting);
+            };
+
+            std::vector<uint8_t> data;
+            data.reserve(block_size);
+            bool ok = false;
+            if (auto entry = zip_get_entry(reader, plan.jobs[i].index)) {
+                ok = zip_decode_entry(
+                    reader,
+                    *entry,
+                    decoder,
+                    [&](const uint8_t* src, size_t n) {
+                        while (n > 0) {
+                            size_t take =
+                                std::min(n, block_size - data.size());
+                            data.insert(data.end(), src, src + take);
+                            src += take;
+                            n -= take;
+                            if (data.size() == block_size) {
+                                stats.bytes += data.size();
+                                push({i, std::move(data), false, false});
+                                data = {};
+                                data.reserve(block_size);
+                            }
+                        }
+                        return !cancelled();
+                    },
+                    &cache
+                );
+            }
+
+            stats.bytes += data.size();
+            push({i, std::move(data), true, !ok});
+            stats.busy += seconds_since(start) - waited;
+            stats.wait += waited;
+        }
+    }
+}
+
+// checks the files of the bundle `selected` picks against the digests, as
+// found under `root`, the ones failing are added to the failed files and so
+// left out of the manifest
+static void verify_installed(
+    const ZipReader* reader,
+    const fs::path& root,
+    const DigestManifest& digests,
+    const PipelineOptions& options,
+    PipelineResult& result,
+    const std::function<bool(std::string_view)>& selected
+) {
+    auto bundle = manifest_from_reader(reader);
+    std::set<std::string, std::less<>> failed(
+        result.extract.failed.begin(), result.extract.failed.end()
+    );
+    // files already known to be bad and anything outside the bundle or the
+    // selection are not read at all
+    auto skip = [&](std::string_view name) {
+        return failed.contains(name) || !bundle.contains(name) ||
+               !selected(name);
+    };
+
+    auto* progress = options.progress;
+    VerifyOptions verify_options{
+        .threads = options.verify_threads,
+        .skip = skip,
+    };
+    if (progress) {
+        uint64_t bytes_total = 0;
+        for (const auto& [name, entry] : digests) {
+            bytes_total += skip(name) ? 0 : entry.size;
+        }
+        progress->bytes_done = 0;
+        progress->bytes_total = bytes_total;
+        progress->verifying = true;
+        verify_options.cancelled = &progress->cancelled;
+        verify_options.bytes_done = &progress->bytes_done;
+    }
+
+    auto verify = verify_digests(root, digests, verify_options);
+    for (const auto& name : verify.failed) {
+        error(std::format("{} does not match its digest", name).c_str());
+        result.extract.failed.push_back(name);
+    }
+    // files of the bundle without a digest cannot be vouched for
+    for (const auto& [name, entry] : bundle) {
+        if (!digests.contains(name) && !failed.contains(name) &&
+            selected(name)) {
+            error(std::format("{} has no digest", name).c_str());
+            result.extract.failed.push_back(name);
+        }
+    }
+    result.cancelled = verify.cancelled;
+    // a transactional install checks the staged and the unchanged files in
+    // two passes, reported as one
+    if (result.verify) {
+        auto& total = *result.verify;
+        total.failed.insert(
+            total.failed.end(), verify.failed.begin(), verify.failed.end()
+        );
+        total.bytes += verify.bytes;
+        total.threads = std::max(total.threads, verify.threads);
+        total.seconds += verify.seconds;
+        total.cancelled = verify.cancelled;
+    } else {
+        result.verify = std::move(verify);
+    }
+}
+
+std::optional<PipelineResult> install_pipelined(
+    ZipReader* reader,
+    const fs::path& install_path,
+    const PipelineOptions& options
+) {
+    auto started = Clock::now();
+    PipelineResult result;
+    std::optional<fs::path> staging;
+    if (options.transactional) {
+        if (!recover_install(install_path)) {
+            error(
+                std::format(
+                    "Failed to recover the interrupted install in {}",
+                    install_path.string()
+                )
+                    .c_str()
+            );
+            return nullopt;
+        }
+        staging = staging_path(install_path);
+    }
+    std::optional<Manifest> installed;
+    if (options.update)
+        installed = read_manifest(install_path, options.component);
+    auto plan = plan_extraction(
+        reader,
+        install_path,
+        result.extract,
+        installed ? &*installed : nullptr,
+        staging ? &*staging : nullptr,
+        options.decode_threads
+    );
+    if (!plan)
+        return nullopt;
+
+    size_t block_size = std::max<size_t>(options.block_size, 1);
+    uint32_t decode_threads =
+        resolve_thread_count(options.decode_threads, plan->batches.size());
+    uint32_t writer_threads =
+        resolve_thread_count(options.writer_threads, plan->jobs.size());
+    result.decode.threads = decode_threads;
+    result.write.threads = writer_threads;
+    FileWriterOptions writer_options{
+        .backend = resolve_write_backend(options.write_backend),
+        .queue_depth = options.write_depth,
+        .sync = options.sync_files,
+    };
+    result.write_backend = writer_options.backend;
+
+    auto* progress = options.progress;
+    if (progress) {
+        uint64_t bytes_total = 0;
+        for (const auto& job : plan->jobs) {
+            bytes_total += job.size;
+        }
+        for (const auto& link : plan->links) {
+            bytes_total += link.size;
+        }
+        progress->bytes_total = bytes_total;
+        progress->files_total =
+            static_cast<uint32_t>(plan->jobs.size() + plan->links.size());
+    }
+
+    std::vector<std::unique_ptr<BlockQueue>> queues;
+    for (uint32_t w = 0; w < writer_threads; ++w) {
+        queues.push_back(std::make_unique<BlockQueue>(
+            std::max<size_t>(options.queue_depth, 1)
+        ));
+    }
+
+    std::atomic<size_t> next{0};
+    std::atomic<uint32_t> files_written{0};
+    // one slot per job, each only ever written by the writer owning the job
+    std::vector<uint8_t> completed(plan->jobs.size());
+    std::mutex failed_mutex;
+    std::vector<ThreadStats> decode_stats(decode_threads);
+    std::vector<ThreadStats> write_stats(writer_threads);
+
+    std::vector<std::thread> writers;
+    for (uint32_t w = 0; w < writer_threads; ++w) {
+        writers.emplace_back([&, w] {
+            write_blocks(
+                *queues[w],
+                plan->jobs,
+                files_written,
+                completed,
+                result.extract.failed,
+                failed_mutex,
+                writer_options,
+                progress,
+                write_stats[w]
+            );
+        });
+    }
+
+    std::vector<std::thread> decoders;
+    for (uint32_t d = 0; d < decode_threads; ++d) {
+        decoders.emplace_back([&, d] {
+            decode_batches(
+                reader,
+                *plan,
+                next,
+                queues,
+                block_size,
+                progress,
+                decode_stats[d]
+            );
+        });
+    }
+
+    for (auto& thread : decoders) {
+        thread.join();
+    }
+    for (auto& queue : queues) {
+        queue->close();
+    }
+    for (auto& thread : writers) {
+        thread.join();
+    }
+
+    for (const auto& stats : decode_stats) {
+        merge_stats(result.decode, stats);
+    }
+    for (const auto& stats : write_stats) {
+        merge_stats(result.write, stats);
+    }
+    result.extract.files_written = files_written;
+    result.extract.bytes_written = result.write.bytes;
+    result.cancelled = progress && progress->cancelled;
+
+    // duplicates are created once their source is on disk, a cheap metadata
+    // operation where reflinks or hardlinks work
+    if (!result.cancelled) {
+        link_duplicates(*plan, options.hardlinks, result.extract);
+        if (progress) {
+            uint64_t linked_bytes = 0;
+            for (const auto& link : plan->links) {
+                linked_bytes += link.done ? link.size : 0;
+            }
+            progress->files_done += result.extract.files_linked;
+            progress->bytes_done += linked_bytes;
+        }
+        // staged files get theirs before they are flushed and published
+        apply_metadata(plan->file_metadata, decode_threads);
+    }
+
+    // files written by this install, the ones a transaction staged
+    std::set<std::string, std::less<>> written;
+    for (const auto& job : plan->jobs) {
+        written.insert(job.name);
+    }
+    for (const auto& link : plan->links) {
+        written.insert(link.name);
+    }
+    auto is_written = [&](std::string_view name) {
+        return written.contains(name);
+    };
+
+    // staged files are checked where they were staged, before anything is
+    // published, so a damaged one never replaces an installed file
+    if (staging && !result.cancelled && result.extract.failed.empty() &&
+        options.digests) {
+        verify_installed(
+            reader, *staging, *options.digests, options, result, is_written
+        );
+        if (!result.extract.failed.empty()) {
+            error(
+                std::format(
+                    "Kept the previous install in {}, {} staged files did "
+                    "not match their digests",
+                    install_path.string(),
+                    result.extract.failed.size()
+                )
+                    .c_str()
+            );
+        }
+    }
+
+    // the staged files are published all at once, or dropped again when any
+    // of them failed
+    if (staging && !result.cancelled && result.extract.failed.empty()) {
+        std::string failure;
+        result.committed = publish_staged(install_path, failure);
+        if (!result.committed) {
+            error(
+                std::format(
+                    "Failed to publish the install into {}: {}",
+                    install_path.string(),
+                    failure
+                )
+                    .c_str()
+            );
+            for (const auto& job : plan->jobs) {
+                result.extract.failed.push_back(job.name);
+            }
+            for (const auto& link : plan->links) {
+                result.extract.failed.push_back(link.name);
+            }
+        }
+    } else if (staging) {
+        discard_staged(install_path);
+    }
+
+    // the whole tree without a transaction, only the files it left alone with
+    // one, the staged ones were checked before they were published
+    if (!result.cancelled && options.digests &&
+        (!staging || result.committed)) {
+        verify_installed(
+            reader,
+            install_path,
+            *options.digests,
+            options,
+            result,
+            [&](std::string_view name) {
+                return !staging || !is_written(name);
+            }
+        );
+    }
+    result.wall_seconds = seconds_since(started);
+
+    // the manifest lists what is known to be on disk: unchanged and freshly
+    // written files, plus stale files a cancelled update did not get to
+    auto bundle = manifest_from_reader(reader);
+    auto manifest = bundle;
+    for (size_t i = 0; i < plan->jobs.size(); ++i) {
+        if (!completed[i])
+            manifest.erase(plan->jobs[i].name);
+    }
+    for (const auto& link : plan->links) {
+        if (!link.done)
+            manifest.erase(link.name);
+    }
+    for (const auto& name : result.extract.failed) {
+        manifest.erase(name);
+    }
+    // a transaction that was not committed left the previous install and its
+    // manifest as they were
+    bool kept_previous = staging && !result.committed;
+    if (installed && !kept_previous) {
+        if (result.cancelled) {
+            for (const auto& [name, entry] : *installed) {
+                if (!bundle.contains(name))
+                    manifest.insert_or_assign(name, entry);
+            }
+        } else {
+            remove_stale_files(
+                install_path, *installed, bundle, result.extract
+            );
+        }
+    }
+    if (!kept_previous) {
+        write_manifest(
+            install_path, manifest, options.component, options.transactional
+        );
+    }
+    // last, nothing is created in or removed from the directories after this
+    if (!result.cancelled && !kept_previous)
+        apply_metadata(plan->directory_metadata, decode_threads);
+
+    // a stage that spends most of its time waiting on the other one is not
+    // the bottleneck
+    info(
+        std::format(
+            "Installed {} files ({} bytes) into {} in {:.2f}s, {} linked, "
+            "{} unchanged, {} removed, {} failed{}",
+            result.extract.files_written,
+            result.extract.bytes_written,
+            install_path.string(),
+            result.wall_seconds,
+            result.extract.files_linked,
+            result.extract.files_unchanged,
+            result.extract.files_removed,
+            result.extract.failed.size(),
+            result.cancelled ? ", cancelled" : ""
+        )
+            .c_str()
+    );
+    info(
+        std::format(
+            "decode: {} threads, {:.1f} MiB/s per thread, {:.2f}s busy, "
+            "{:.2f}s blocked on writers",
+            result.decode.threads,
+            result.decode.throughput() / (1024 * 1024),
+            result.decode.busy_seconds,
+            result.decode.wait_seconds
+        )
+            .c_str()
+    );
+    info(
+        std::format(
+            "write: {} threads ({}), {:.1f} MiB/s per thread, {:.2f}s busy, "
+            "{:.2f}s idle",
+            result.write.threads,
+            write_backend_name(result.write_backend),
+            result.write.throughput() / (1024 * 1024),
+            result.write.busy_seconds,
+            result.write.wait_seconds
+        )
+            .c_str()
+    );
+    if (result.verify) {
+        info(
+            std::format(
+                "verify: {} threads, {} bytes in {:.2f}s, {:.1f} MiB/s, {} "
+                "mismatched",
+                result.verify->threads,
+                result.verify->bytes,
+                result.verify->seconds,
+                result.verify->seconds > 0
+                    ? result.verify->bytes / result.verify->seconds /
+                          (1024 * 1024)
+                    : 0.0,
+                result.verify->failed.size()
+            )
+                .c_str()
+        );
+    }
+
+    return result;
+}
+
+}  // namespace encoding
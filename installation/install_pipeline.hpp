@@ -0,0 +1,123 @@
+#ifndef KONDUIT_INSTALLER_INSTALL_PIPELINE_HPP
+#define KONDUIT_INSTALLER_INSTALL_PIPELINE_HPP
+
+#include <atomic>
+#include <filesystem>
+#include <optional>
+#include "digests.hpp"
+#include "extraction.hpp"
+#include "file_writer.hpp"
+#include "manifest.hpp"
+
+namespace encoding {
+
+/// live counters of a running install, written by the pipeline threads and
+/// safe to read from any other thread
+struct InstallProgress {
+    std::atomic<uint64_t> bytes_done{0};
+    std::atomic<uint64_t> bytes_total{0};
+    std::atomic<uint32_t> files_done{0};
+    std::atomic<uint32_t> files_total{0};
+    /// archive index of the entry a decoder picked up last, UINT32_MAX
+    /// before the first one
+    std::atomic<uint32_t> current_entry{UINT32_MAX};
+    /// stops the install as soon as the workers notice, files that were not
+    /// finished are removed
+    std::atomic<bool> cancelled{false};
+    /// set once extraction is done and the digests are checked, the byte
+    /// counters restart for the files being verified
+    std::atomic<bool> verifying{false};
+};
+
+struct PipelineOptions {
+    /// size of the blocks handed from the decode to the write stage
+    size_t block_size = EXTRACT_BUFFER_SIZE;
+    /// blocks in flight per writer before decoders block, bounds the memory
+    /// to writer_threads * queue_depth * block_size
+    size_t queue_depth = 16;
+    /// 0 uses every hardware thread
+    uint32_t decode_threads = 0;
+    uint32_t writer_threads = 2;
+    /// how the writer threads put the files on disk, with io_uring each of
+    /// them keeps up to write_depth operations of many files in flight
+    WriteBackend write_backend = WriteBackend::AUTO;
+    uint32_t write_depth = 64;
+    /// fsync every file before it counts as written
+    bool sync_files = false;
+    /// compare the bundle against the manifest of the previous install,
+    /// extract only new and changed files and delete removed ones
+    bool update = false;
+    /// stage the files below the install path and publish all of them or
+    /// none, see transaction.hpp, a failed or cancelled install leaves the
+    /// previous one as it was
+    bool transactional = false;
+    /// component the bundle installs, it only updates and removes files
+    /// listed in that component's manifest
+    std::string_view component = CORE_COMPONENT;
+    /// see ExtractOptions::hardlinks
+    bool hardlinks = true;
+    /// optional, every file of the bundle is checked against it after the
+    /// install, files that do not match count as failed
+    const DigestManifest* digests = nullptr;
+    /// threads hashing the installed files, 0 uses every hardware thread
+    uint32_t verify_threads = 0;
+    /// optional, updated while the install runs
+    InstallProgress* progress = nullptr;
+};
+
+/// time one stage spent working and waiting on the other, summed over its
+/// threads
+struct StageStats {
+    uint32_t threads = 0;
+    uint64_t bytes = 0;
+    double busy_seconds = 0;
+    double wait_seconds = 0;
+
+    /// bytes per second of busy time per thread
+    double throughput() const;
+};
+
+struct PipelineResult {
+    ExtractResult extract;
+    StageStats decode;
+    StageStats write;
+    /// the backend the writers were started with, one whose ring cannot be
+    /// set up still falls back to threads on its own
+    WriteBackend write_backend = WriteBackend::THREADS;
+    /// nullopt when no digests were given or the install was cancelled
+    /// before they were checked
+    std::optional<VerifyResult> verify;
+    double wall_seconds = 0;
+    bool cancelled = false;
+    /// a transactional install published its files, when false nothing of
+    /// the previous install was touched
+    bool committed = false;
+};
+
+/// extracts the archive under `install_path` with decode workers feeding
+/// bounded queues drained by writer threads, so inflating and writing
+/// overlap instead of alternating
+///
+/// the blocks of a file always go through the same writer in order, a file
+/// that fails to decode is removed again
+///
+/// with digests the whole installed tree is verified afterwards, unchanged
+/// files included, so a damaged install is noticed and repaired by an update,
+/// a transactional install checks its staged files before publishing them
+/// and keeps the previous install when one of them does not match
+///
+/// a manifest of what ended up installed is written afterwards, also when the
+/// install was cancelled, so the next update knows what to redo, a
+/// transactional install only writes it once committed
+///
+/// a transactional install first recovers one a crash interrupted and
+/// returns nullopt when that fails
+std::optional<PipelineResult> install_pipelined(
+    ZipReader* reader,
+    const std::filesystem::path& install_path,
+    const PipelineOptions& options = {}
+);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_INSTALL_PIPELINE_HPP
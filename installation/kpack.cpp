@@ -0,0 +1,102 @@
+#include "kpack.hpp"
+
+#include <cstring>
+
+namespace encoding {
+
+uint64_t pack_hash(const void* data, size_t size) {
+    auto* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t pack_hash(std::string_view text) {
+    return pack_hash(text.data(), text.size());
+}
+
+bool is_pack(const uint8_t* data, size_t size) {
+    return data && size >= sizeof(PackHeader) &&
+           std::memcmp(data, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0;
+}
+
+static bool
+table_fits(uint64_t offset, uint64_t count, uint64_t item, size_t size) {
+    return offset <= size && count <= (size - offset) / item;
+}
+
+std::optional<PackView> pack_open_view(const uint8_t* data, size_t size) {
+    if (!is_pack(data, size) ||
+        reinterpret_cast<uintptr_t>(data) % alignof(PackEntry) != 0) {
+        return std::nullopt;
+    }
+
+    auto* header = reinterpret_cast<const PackHeader*>(data);
+    bool slots_pow2 =
+        header->slot_count != 0 &&
+        (header->slot_count & (header->slot_count - 1)) == 0;
+    if (header->version != PACK_VERSION ||
+        header->header_size != sizeof(PackHeader) ||
+        header->entry_size != sizeof(PackEntry) ||
+        header->chunk_size != sizeof(PackChunk) || !slots_pow2 ||
+        header->slot_count <= header->entry_count ||
+        header->entries_offset % alignof(PackEntry) != 0 ||
+        header->chunks_offset % alignof(PackChunk) != 0 ||
+        header->slots_offset % alignof(PackSlot) != 0 ||
+        !table_fits(
+            header->entries_offset, header->entry_count, sizeof(PackEntry), size
+        ) ||
+        !table_fits(
+            header->chunks_offset, header->chunk_count, sizeof(PackChunk), size
+        ) ||
+        !table_fits(
+            header->slots_offset, header->slot_count, sizeof(PackSlot), size
+        ) ||
+        !table_fits(header->names_offset, header->names_size, 1, size)) {
+        return std::nullopt;
+    }
+
+    return PackView{
+        .header = header,
+        .entries =
+            reinterpret_cast<const PackEntry*>(data + header->entries_offset),
+        .chunks =
+            reinterpret_cast<const PackChunk*>(data + header->chunks_offset),
+        .slots = reinterpret_cast<const PackSlot*>(data + header->slots_offset),
+        .names = reinterpret_cast<const char*>(data + header->names_offset),
+    };
+}
+
+std::string_view pack_entry_name(const PackView& view, const PackEntry& entry) {
+    uint64_t end = static_cast<uint64_t>(entry.name_offset) + entry.name_size;
+    if (end > view.header->names_size)
+        return {};
+    return {view.names + entry.name_offset, entry.name_size};
+}
+
+std::optional<uint32_t> pack_find(const PackView& view, std::string_view name) {
+    uint64_t hash = pack_hash(name);
+    uint32_t mask = view.header->slot_count - 1;
+    // the table is never full, so an empty slot always ends the probe, the
+    // count bound only guards against a corrupt table
+    for (uint32_t probe = 0, slot = static_cast<uint32_t>(hash) & mask;
+         probe < view.header->slot_count;
+         ++probe, slot = (slot + 1) & mask) {
+        const auto& s = view.slots[slot];
+        if (s.entry == 0)
+            return std::nullopt;
+        if (s.hash != static_cast<uint32_t>(hash) ||
+            s.entry > view.header->entry_count) {
+            continue;
+        }
+        uint32_t index = s.entry - 1;
+        if (pack_entry_name(view, view.entries[index]) == name)
+            return index;
+    }
+    return std::nullopt;
+}
+
+}  // namespace encoding
@@ -0,0 +1,128 @@
+#ifndef KONDUIT_INSTALLER_KPACK_HPP
+#define KONDUIT_INSTALLER_KPACK_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// konduit pack (.kpak) layout, shared by the installer and konduit_pack
+//
+// [PackHeader][PackEntry * entry_count][PackChunk * chunk_count]
+// [PackSlot * slot_count][names][data]
+//
+// everything up to the names is fixed size and 64 byte aligned, so a mapped
+// or embedded pack is used in place without parsing anything, payloads are
+// aligned to PACK_DATA_ALIGNMENT and decoded independently of each other
+//
+// small files can be packed solid: concatenated into a chunk that is
+// compressed as one payload, their entries then point into the decoded chunk
+
+namespace encoding {
+
+static_assert(
+    std::endian::native == std::endian::little,
+    "konduit packs are little endian and read in place"
+);
+
+constexpr char PACK_MAGIC[8] = {'K', 'D', 'T', 'P', 'A', 'C', 'K', '\0'};
+constexpr uint32_t PACK_VERSION = 2;
+constexpr size_t PACK_ALIGNMENT = 64;
+constexpr size_t PACK_DATA_ALIGNMENT = 16;
+
+constexpr uint8_t PACK_ENTRY_DIRECTORY = 1 << 0;
+/// the entry lives inside a solid chunk, data_offset is relative to the
+/// decoded chunk and compressed_size is 0
+constexpr uint8_t PACK_ENTRY_SOLID = 1 << 1;
+
+struct PackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t entry_count;
+    uint32_t entry_size;
+    uint32_t slot_count;
+    uint32_t flags;
+    uint64_t entries_offset;
+    uint64_t slots_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint32_t chunk_count;
+    uint32_t chunk_size;
+    uint64_t chunks_offset;
+    uint8_t reserved[48];
+};
+static_assert(sizeof(PackHeader) == 128);
+
+struct PackEntry {
+    uint64_t data_offset;
+    uint64_t compressed_size;
+    uint64_t uncompressed_size;
+    /// pack_hash of the uncompressed contents
+    uint64_t content_hash;
+    uint32_t name_offset;
+    uint32_t name_size;
+    uint32_t crc32;
+    /// unix permission bits
+    uint32_t mode;
+    /// seconds since the unix epoch
+    int64_t mtime;
+    uint8_t codec;
+    uint8_t flags;
+    uint16_t reserved0;
+    /// index into the chunk table for PACK_ENTRY_SOLID entries
+    uint32_t chunk;
+};
+static_assert(sizeof(PackEntry) == 64);
+
+struct PackChunk {
+    uint64_t data_offset;
+    uint64_t compressed_size;
+    uint64_t uncompressed_size;
+    uint8_t codec;
+    uint8_t reserved[7];
+};
+static_assert(sizeof(PackChunk) == 32);
+
+/// open-addressing table over the entry names built by konduit_pack, probed
+/// linearly from pack_hash(name) & (slot_count - 1)
+struct PackSlot {
+    /// entry index + 1, 0 marks an empty slot
+    uint32_t entry;
+    /// low half of the name hash, rejects most mismatches without touching
+    /// the name
+    uint32_t hash;
+};
+static_assert(sizeof(PackSlot) == 8);
+
+/// typed pointers into a validated pack
+struct PackView {
+    const PackHeader* header;
+    const PackEntry* entries;
+    const PackChunk* chunks;
+    const PackSlot* slots;
+    const char* names;
+};
+
+/// 64-bit FNV-1a, used for names and content hashes
+uint64_t pack_hash(const void* data, size_t size);
+uint64_t pack_hash(std::string_view text);
+
+constexpr uint64_t pack_align(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool is_pack(const uint8_t* data, size_t size);
+
+/// checks the header and the table bounds, `data` has to be aligned to
+/// alignof(PackEntry) for the view to be usable in place
+std::optional<PackView> pack_open_view(const uint8_t* data, size_t size);
+
+std::optional<uint32_t> pack_find(const PackView& view, std::string_view name);
+
+std::string_view pack_entry_name(const PackView& view, const PackEntry& entry);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_KPACK_HPP
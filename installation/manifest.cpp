@@ -0,0 +1,131 @@
+#include "manifest.hpp"
+
+#include <charconv>
+#include "file_writer.hpp"
+
+namespace encoding {
+
+namespace fs = std::filesystem;
+
+// one line per file: "<crc32 hex> <size> <name>", the name runs to the end of
+// the line so it may contain spaces
+
+Manifest manifest_from_reader(const ZipReader* reader) {
+    Manifest manifest;
+    for (uint32_t i = 0; reader && i < reader->total_files; ++i) {
+        auto entry = zip_get_entry(reader, i);
+        if (!entry || entry->is_directory)
+            continue;
+        manifest.insert_or_assign(
+            std::string(entry->name),
+            ManifestEntry{entry->uncompressed_size, entry->crc32}
+        );
+    }
+    return manifest;
+}
+
+static std::optional<std::pair<std::string, ManifestEntry>>
+parse_line(std::string_view line) {
+    auto crc_end = line.find(' ');
+    if (crc_end == std::string_view::npos)
+        return nullopt;
+    auto size_end = line.find(' ', crc_end + 1);
+    if (size_end == std::string_view::npos || size_end + 1 >= line.size())
+        return nullopt;
+
+    ManifestEntry entry{};
+    auto crc =
+        std::from_chars(line.data(), line.data() + crc_end, entry.crc32, 16);
+    auto size = std::from_chars(
+        line.data() + crc_end + 1, line.data() + size_end, entry.size
+    );
+    if (crc.ec != std::errc() || size.ec != std::errc())
+        return nullopt;
+    return std::pair{std::string(line.substr(size_end + 1)), entry};
+}
+
+fs::path
+manifest_path(const fs::path& install_path, std::string_view component) {
+    if (component.empty() || component == CORE_COMPONENT)
+        return install_path / MANIFEST_NAME;
+    return install_path / std::format("{}.{}", MANIFEST_NAME, component);
+}
+
+std::optional<Manifest>
+read_manifest(const fs::path& install_path, std::string_view component) {
+    std::ifstream file(manifest_path(install_path, component));
+    if (!file)
+        return nullopt;
+
+    Manifest manifest;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty())
+            continue;
+        auto parsed = parse_line(line);
+        if (!parsed) {
+            error(
+                std::format(
+                    "Ignoring corrupt manifest in {}", install_path.string()
+                )
+                    .c_str()
+            );
+            return nullopt;
+        }
+        manifest.insert_or_assign(std::move(parsed->first), parsed->second);
+    }
+    return manifest;
+}
+
+bool write_manifest(
+    const fs::path& install_path,
+    const Manifest& manifest,
+    std::string_view component,
+    bool sync
+) {
+    auto path = manifest_path(install_path, component);
+    auto temp = path;
+    temp += ".tmp";
+
+    {
+        std::ofstream file(temp, std::ios::trunc);
+        for (const auto& [name, entry] : manifest) {
+            file << std::format(
+                "{:08x} {} {}\n", entry.crc32, entry.size, name
+            );
+        }
+        file.close();
+        if (file.fail()) {
+            error(std::format("Failed to write {}", temp.string()).c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    if (sync && !sync_file(temp)) {
+        error(std::format("Failed to flush {}", temp.string()).c_str());
+        fs::remove(temp, ec);
+        return false;
+    }
+    fs::rename(temp, path, ec);
+    if (ec) {
+        error(
+            std::format(
+                "Failed to replace {}: {}", path.string(), ec.message()
+            )
+                .c_str()
+        );
+        fs::remove(temp, ec);
+        return false;
+    }
+    if (sync)
+        sync_directory(install_path);
+    return true;
+}
+
+bool has_manifest(const fs::path& install_path) {
+    std::error_code ec;
+    return fs::is_regular_file(install_path / MANIFEST_NAME, ec);
+}
+
+}  // namespace encoding
@@ -0,0 +1,60 @@
+#ifndef KONDUIT_INSTALLER_MANIFEST_HPP
+#define KONDUIT_INSTALLER_MANIFEST_HPP
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "encoding_handling.hpp"
+
+namespace encoding {
+
+/// written into the install directory after every install, its presence
+/// marks the directory as an existing install that can be updated in place
+constexpr const char* MANIFEST_NAME = ".konduit-manifest";
+
+/// the component every installer ships, its manifest is MANIFEST_NAME, the
+/// optional ones keep theirs in MANIFEST_NAME.<component> so updating one
+/// component never touches the files of another
+constexpr std::string_view CORE_COMPONENT = "core";
+
+struct ManifestEntry {
+    uint64_t size;
+    uint32_t crc32;
+};
+
+/// installed files by archive entry name
+using Manifest = std::map<std::string, ManifestEntry, std::less<>>;
+
+/// every file entry of the bundle
+Manifest manifest_from_reader(const ZipReader* reader);
+
+std::filesystem::path manifest_path(
+    const std::filesystem::path& install_path,
+    std::string_view component = CORE_COMPONENT
+);
+
+/// nullopt when `install_path` holds no manifest for `component` or it
+/// cannot be parsed
+std::optional<Manifest> read_manifest(
+    const std::filesystem::path& install_path,
+    std::string_view component = CORE_COMPONENT
+);
+
+/// replaces the manifest atomically, a crash mid write leaves the old one,
+/// with `sync` the new one is flushed before and its directory after the
+/// rename so it also survives a crash right after
+bool write_manifest(
+    const std::filesystem::path& install_path,
+    const Manifest& manifest,
+    std::string_view component = CORE_COMPONENT,
+    bool sync = false
+);
+
+bool has_manifest(const std::filesystem::path& install_path);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_MANIFEST_HPP
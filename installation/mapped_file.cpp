@@ -0,0 +1,175 @@
+#include "mapped_file.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace encoding {
+
+MappedFile::MappedFile()
+    : data(nullptr), size(0), view(nullptr), view_size(0) {}
+
+MappedFile::~MappedFile() {
+    if (!view)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(view);
+#else
+    munmap(const_cast<uint8_t*>(view), view_size);
+#endif
+}
+
+#if defined(_WIN32)
+
+static HANDLE open_for_mapping(const std::filesystem::path& path) {
+    return CreateFileW(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+    );
+}
+
+// views have to start on the allocation granularity, not just a page
+static std::unique_ptr<MappedFile>
+map_view(HANDLE file, uint64_t offset, size_t size) {
+    HANDLE mapping =
+        CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+        return nullptr;
+
+    SYSTEM_INFO system;
+    GetSystemInfo(&system);
+    uint64_t start = offset - offset % system.dwAllocationGranularity;
+    size_t view_size = static_cast<size_t>(size + (offset - start));
+
+    // the view keeps the mapping object alive on its own
+    void* view = MapViewOfFile(
+        mapping,
+        FILE_MAP_READ,
+        static_cast<DWORD>(start >> 32),
+        static_cast<DWORD>(start),
+        view_size
+    );
+    CloseHandle(mapping);
+    if (!view)
+        return nullptr;
+
+    auto mapped = std::make_unique<MappedFile>();
+    mapped->view = static_cast<const uint8_t*>(view);
+    mapped->view_size = view_size;
+    mapped->data = mapped->view + (offset - start);
+    mapped->size = size;
+    return mapped;
+}
+
+std::unique_ptr<MappedFile> map_file(const std::filesystem::path& path) {
+    HANDLE file = open_for_mapping(path);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER file_size;
+    std::unique_ptr<MappedFile> mapped;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart != 0) {
+        mapped = map_view(file, 0, static_cast<size_t>(file_size.QuadPart));
+    }
+    CloseHandle(file);
+    return mapped;
+}
+
+std::unique_ptr<MappedFile> map_file_region(
+    const std::filesystem::path& path,
+    uint64_t offset,
+    size_t size
+) {
+    HANDLE file = open_for_mapping(path);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER file_size;
+    std::unique_ptr<MappedFile> mapped;
+    if (GetFileSizeEx(file, &file_size) && size != 0 &&
+        offset <= static_cast<uint64_t>(file_size.QuadPart) &&
+        size <= static_cast<uint64_t>(file_size.QuadPart) - offset) {
+        mapped = map_view(file, offset, size);
+    }
+    CloseHandle(file);
+    return mapped;
+}
+
+#else
+
+// mmap offsets have to be page aligned, the view starts on the page holding
+// `offset`
+static std::unique_ptr<MappedFile>
+map_view(int fd, uint64_t offset, size_t size) {
+    static const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t start = offset & ~(page - 1);
+    size_t view_size = static_cast<size_t>(size + (offset - start));
+
+    // the mapping stays valid after the descriptor is closed
+    void* view = mmap(
+        nullptr,
+        view_size,
+        PROT_READ,
+        MAP_PRIVATE,
+        fd,
+        static_cast<off_t>(start)
+    );
+    if (view == MAP_FAILED)
+        return nullptr;
+
+    auto mapped = std::make_unique<MappedFile>();
+    mapped->view = static_cast<const uint8_t*>(view);
+    mapped->view_size = view_size;
+    mapped->data = mapped->view + (offset - start);
+    mapped->size = size;
+    return mapped;
+}
+
+std::unique_ptr<MappedFile> map_file(const std::filesystem::path& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st {};
+    std::unique_ptr<MappedFile> mapped;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size != 0)
+        mapped = map_view(fd, 0, static_cast<size_t>(st.st_size));
+    close(fd);
+    return mapped;
+}
+
+std::unique_ptr<MappedFile> map_file_region(
+    const std::filesystem::path& path,
+    uint64_t offset,
+    size_t size
+) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st {};
+    std::unique_ptr<MappedFile> mapped;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && size != 0 &&
+        offset <= static_cast<uint64_t>(st.st_size) &&
+        size <= static_cast<uint64_t>(st.st_size) - offset) {
+        mapped = map_view(fd, offset, size);
+    }
+    close(fd);
+    return mapped;
+}
+
+#endif
+
+}  // namespace encoding
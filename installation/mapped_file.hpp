@@ -0,0 +1,41 @@
+#ifndef KONDUIT_INSTALLER_MAPPED_FILE_HPP
+#define KONDUIT_INSTALLER_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+namespace encoding {
+
+/// read-only view of a whole file, pages are only faulted in when touched
+///
+/// kept free of raylib and platform headers so the windows implementation
+/// does not clash with raylib names
+struct MappedFile {
+    const uint8_t* data;
+    size_t size;
+    /// what was actually mapped, `data` may start past it when the region did
+    /// not begin on a page boundary
+    const uint8_t* view;
+    size_t view_size;
+
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+std::unique_ptr<MappedFile> map_file(const std::filesystem::path& path);
+
+/// maps only `size` bytes from `offset` on, which has no alignment
+/// requirements, `data` keeps the offset's alignment within a page
+std::unique_ptr<MappedFile> map_file_region(
+    const std::filesystem::path& path,
+    uint64_t offset,
+    size_t size
+);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_MAPPED_FILE_HPP
@@ -0,0 +1,116 @@
+#include "payload.hpp"
+
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach-o/dyld.h>
+#endif
+
+namespace encoding {
+
+namespace fs = std::filesystem;
+
+std::optional<fs::path> self_executable_path() {
+#if defined(_WIN32)
+    std::wstring path(MAX_PATH, L'\0');
+    for (;;) {
+        DWORD length = GetModuleFileNameW(
+            nullptr, path.data(), static_cast<DWORD>(path.size())
+        );
+        if (length == 0)
+            return std::nullopt;
+        if (length < path.size()) {
+            path.resize(length);
+            return fs::path(path);
+        }
+        path.resize(path.size() * 2);
+    }
+#elif defined(__APPLE__)
+    uint32_t size = 0;
+    _NSGetExecutablePath(nullptr, &size);
+    std::string path(size, '\0');
+    if (_NSGetExecutablePath(path.data(), &size) != 0)
+        return std::nullopt;
+    path.resize(std::strlen(path.c_str()));
+    return fs::path(path);
+#elif defined(__linux__)
+    // opens the running image even if it was moved or replaced since
+    return fs::path("/proc/self/exe");
+#else
+    return std::nullopt;
+#endif
+}
+
+static bool fits(uint64_t offset, uint64_t size, uint64_t total) {
+    return offset <= total && size <= total - offset;
+}
+
+std::unique_ptr<AppendedPayload>
+open_appended_payload(const fs::path& executable) {
+    std::ifstream file(executable, std::ios::binary | std::ios::ate);
+    if (!file)
+        return nullptr;
+    auto file_size = static_cast<uint64_t>(file.tellg());
+    if (file_size < sizeof(PayloadTrailer))
+        return nullptr;
+
+    PayloadTrailer trailer;
+    file.seekg(static_cast<std::streamoff>(file_size - sizeof(trailer)));
+    if (!file.read(reinterpret_cast<char*>(&trailer), sizeof(trailer)))
+        return nullptr;
+    file.close();
+    if (std::memcmp(trailer.magic, PAYLOAD_MAGIC, sizeof(PAYLOAD_MAGIC)) !=
+            0 ||
+        trailer.version != PAYLOAD_VERSION) {
+        return nullptr;
+    }
+
+    uint64_t payload_end = file_size - sizeof(trailer);
+    if (trailer.payload_offset >= payload_end)
+        return nullptr;
+    uint64_t payload_size = payload_end - trailer.payload_offset;
+    uint64_t records_size =
+        uint64_t{trailer.record_count} * sizeof(PayloadRecord);
+    if (!fits(trailer.records_offset, records_size, payload_size) ||
+        trailer.records_offset % alignof(PayloadRecord) != 0) {
+        return nullptr;
+    }
+
+    auto payload = std::make_unique<AppendedPayload>();
+    payload->mapped = map_file_region(
+        executable, trailer.payload_offset, static_cast<size_t>(payload_size)
+    );
+    if (!payload->mapped)
+        return nullptr;
+
+    const uint8_t* base = payload->mapped->data;
+    auto* records =
+        reinterpret_cast<const PayloadRecord*>(base + trailer.records_offset);
+    uint64_t names_offset = trailer.records_offset + records_size;
+    uint64_t names_size = payload_size - names_offset;
+    auto* names = reinterpret_cast<const char*>(base + names_offset);
+
+    for (uint32_t i = 0; i < trailer.record_count; ++i) {
+        const auto& record = records[i];
+        if (!fits(record.data_offset, record.data_size, names_offset) ||
+            !fits(record.digests_offset, record.digests_size, names_offset) ||
+            !fits(record.name_offset, record.name_size, names_size) ||
+            !fits(record.component_offset, record.component_size, names_size)) {
+            return nullptr;
+        }
+        payload->bundles.push_back(
+            {{names + record.component_offset, record.component_size},
+             {names + record.name_offset, record.name_size},
+             {base + record.data_offset, record.data_size},
+             {base + record.digests_offset, record.digests_size}}
+        );
+    }
+    return payload;
+}
+
+}  // namespace encoding
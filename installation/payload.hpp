@@ -0,0 +1,86 @@
+#ifndef KONDUIT_INSTALLER_PAYLOAD_HPP
+#define KONDUIT_INSTALLER_PAYLOAD_HPP
+
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "mapped_file.hpp"
+
+// appended payload layout, written by konduit_append behind a finished
+// installer executable instead of #embedding the bundles into it
+//
+// [executable][bundles and digests][PayloadRecord * record_count][names]
+// [PayloadTrailer]
+//
+// the trailer sits at the very end of the file so the installer finds it
+// without knowing how large its own image is, every bundle starts on a
+// PAYLOAD_ALIGNMENT boundary of the file so mapped konduit packs are used in
+// place like #embedded ones
+
+namespace encoding {
+
+static_assert(
+    std::endian::native == std::endian::little,
+    "appended payloads are little endian and read in place"
+);
+
+constexpr char PAYLOAD_MAGIC[8] = {'K', 'D', 'T', 'P', 'A', 'Y', 'L', 'D'};
+constexpr uint32_t PAYLOAD_VERSION = 1;
+constexpr size_t PAYLOAD_ALIGNMENT = 64;
+
+struct PayloadTrailer {
+    /// file offset of the first bundle, everything below is relative to it
+    uint64_t payload_offset;
+    uint64_t records_offset;
+    uint32_t record_count;
+    uint32_t version;
+    char magic[8];
+};
+static_assert(sizeof(PayloadTrailer) == 32);
+
+struct PayloadRecord {
+    uint64_t data_offset;
+    uint64_t data_size;
+    /// digests_size is 0 for a bundle that was appended without digests
+    uint64_t digests_offset;
+    uint64_t digests_size;
+    /// the names follow the records
+    uint32_t name_offset;
+    uint32_t name_size;
+    uint32_t component_offset;
+    uint32_t component_size;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(PayloadRecord) == 64);
+
+/// one bundle of the installer, #embedded or appended
+struct PayloadBundle {
+    std::string_view component;
+    std::string_view name;
+    std::span<const uint8_t> data;
+    /// konduit_pack digests, empty when there are none
+    std::span<const uint8_t> digests;
+};
+
+/// the bundles point into `mapped` and stay valid as long as it does
+struct AppendedPayload {
+    std::unique_ptr<MappedFile> mapped;
+    std::vector<PayloadBundle> bundles;
+};
+
+/// path of the running executable, /proc/self/exe on linux
+std::optional<std::filesystem::path> self_executable_path();
+
+/// nullptr when `executable` carries no payload or its trailer does not
+/// check out, only the payload region is mapped
+std::unique_ptr<AppendedPayload>
+open_appended_payload(const std::filesystem::path& executable);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_PAYLOAD_HPP
@@ -0,0 +1,146 @@
+#include "resource_cache.hpp"
+#include "scratch.hpp"
+
+namespace encoding {
+
+std::unique_ptr<ResourceCache>
+resource_cache_open(std::shared_ptr<ZipReader> reader, size_t budget) {
+    if (!reader) {
+        error("Invalid ZIP reader");
+        return nullptr;
+    }
+    auto cache = std::make_unique<ResourceCache>();
+    cache->reader = std::move(reader);
+    cache->budget = budget;
+    return cache;
+}
+
+std::optional<ResourceHandle>
+resource_open(ResourceCache& cache, std::string_view name) {
+    auto entry = zip_find_entry(cache.reader.get(), name);
+    if (!entry || entry->is_directory)
+        return nullopt;
+    return ResourceHandle{&cache, entry->index};
+}
+
+static void evict_until_fits(ResourceCache& cache, size_t size) {
+    while (!cache.recent.empty() && cache.used + size > cache.budget) {
+        auto it = cache.cached.find(cache.recent.back());
+        cache.used -= it->second.data->size();
+        cache.cached.erase(it);
+        cache.recent.pop_back();
+    }
+}
+
+// decodes an entry larger than the budget into a scratch file on disk and
+// maps it, so its pages can be dropped and read back instead of being held
+static std::shared_ptr<const MappedFile>
+spill_entry(ResourceCache& cache, const ZipEntry& entry) {
+    auto file = scratch_create(ScratchBacking::DISK);
+    if (!file)
+        return nullptr;
+    bool ok = zip_decode_entry(
+        cache.reader.get(),
+        entry,
+        cache.decoder,
+        [&](const uint8_t* data, size_t size) {
+            return scratch_append(*file, {data, size});
+        },
+        &cache.chunks
+    );
+    if (!ok)
+        return nullptr;
+    return scratch_map(*file);
+}
+
+std::optional<Resource> resource_get(const ResourceHandle& handle) {
+    if (!handle.cache)
+        return nullopt;
+    auto& cache = *handle.cache;
+    std::lock_guard lock(cache.mutex);
+
+    if (auto view = zip_stored_entry_view(cache.reader.get(), handle.index)) {
+        auto [it, first] = cache.stored_verified.try_emplace(handle.index);
+        if (first) {
+            auto entry = zip_get_entry(cache.reader.get(), handle.index);
+            auto crc = crc32_update(CRC32_INIT, view->data(), view->size());
+            it->second = entry && crc == entry->crc32;
+            if (!it->second) {
+                error(
+                    std::format(
+                        "{} is corrupt: got crc {:08x}, expected {:08x}",
+                        entry ? entry->name : std::string_view(),
+                        crc,
+                        entry ? entry->crc32 : 0
+                    )
+                        .c_str()
+                );
+            }
+        }
+        if (!it->second)
+            return nullopt;
+        return Resource{nullptr, *view};
+    }
+
+    if (auto it = cache.cached.find(handle.index); it != cache.cached.end()) {
+        cache.recent.splice(
+            cache.recent.begin(), cache.recent, it->second.recent
+        );
+        return Resource{it->second.data, *it->second.data};
+    }
+
+    auto entry = zip_get_entry(cache.reader.get(), handle.index);
+    if (!entry)
+        return nullopt;
+
+    if (entry->uncompressed_size > cache.budget) {
+        auto it = cache.spilled.find(handle.index);
+        if (it == cache.spilled.end()) {
+            auto mapped = spill_entry(cache, *entry);
+            if (!mapped) {
+                error(
+                    std::format("Failed to extract data for {}", entry->name)
+                        .c_str()
+                );
+                return nullopt;
+            }
+            it = cache.spilled.emplace(handle.index, std::move(mapped)).first;
+        }
+        const auto& mapped = it->second;
+        return Resource{mapped, {mapped->data, mapped->size}};
+    }
+
+    auto data = std::make_shared<std::vector<uint8_t>>();
+    data->reserve(static_cast<size_t>(entry->uncompressed_size));
+    auto append = [&](const uint8_t* bytes, size_t size) {
+        data->insert(data->end(), bytes, bytes + size);
+        return true;
+    };
+    if (!zip_decode_entry(
+            cache.reader.get(), *entry, cache.decoder, append, &cache.chunks
+        )) {
+        error(
+            std::format("Failed to extract data for {}", entry->name).c_str()
+        );
+        return nullopt;
+    }
+
+    evict_until_fits(cache, data->size());
+    cache.recent.push_front(handle.index);
+    cache.cached.emplace(
+        handle.index, ResourceCache::Cached{data, cache.recent.begin()}
+    );
+    cache.used += data->size();
+    return Resource{data, *data};
+}
+
+void resource_cache_clear(ResourceCache& cache) {
+    std::lock_guard lock(cache.mutex);
+    cache.cached.clear();
+    cache.spilled.clear();
+    cache.chunks = {};
+    cache.recent.clear();
+    cache.used = 0;
+}
+
+}  // namespace encoding
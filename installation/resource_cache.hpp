@@ -0,0 +1,90 @@
+#ifndef KONDUIT_INSTALLER_RESOURCE_CACHE_HPP
+#define KONDUIT_INSTALLER_RESOURCE_CACHE_HPP
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "encoding_handling.hpp"
+
+namespace encoding {
+
+constexpr size_t DEFAULT_RESOURCE_BUDGET = 16 * 1024 * 1024;
+
+/// decoded bytes of one entry, `owner` keeps them alive after the cache
+/// evicted them and is empty for stored entries, which point straight into
+/// the archive
+struct Resource {
+    /// the decoded buffer, or the mapping of a scratch file
+    std::shared_ptr<const void> owner;
+    std::span<const uint8_t> bytes;
+};
+
+/// decodes single entries of a bundle on first use and keeps the most
+/// recently used ones around up to `budget` bytes, for screens that only
+/// need a license text or an icon out of a large bundle
+///
+/// safe to use from several threads, the solid chunk of the last solid entry
+/// is kept on top of the budget, in the cache and not the reader so a reader
+/// shared with an install is only ever read
+struct ResourceCache {
+    struct Cached {
+        std::shared_ptr<const std::vector<uint8_t>> data;
+        std::list<uint32_t>::iterator recent;
+    };
+
+    std::shared_ptr<ZipReader> reader;
+    size_t budget;
+    size_t used = 0;
+    std::mutex mutex;
+    Decoder decoder;
+    ChunkCache chunks;
+    /// entry indices, most recently used first
+    std::list<uint32_t> recent;
+    std::unordered_map<uint32_t, Cached> cached;
+    /// entries larger than the budget, decoded once into a scratch file on
+    /// disk and mapped, they are outside the budget as the kernel can drop
+    /// and read back their pages
+    std::unordered_map<uint32_t, std::shared_ptr<const MappedFile>> spilled;
+    /// stored entries checked against their CRC-32 so far, and whether they
+    /// matched, they are never copied so the check is all that is remembered
+    std::unordered_map<uint32_t, bool> stored_verified;
+};
+
+/// cheap to copy, refers to an entry by index, nothing is decoded until the
+/// first resource_get
+struct ResourceHandle {
+    ResourceCache* cache;
+    uint32_t index;
+};
+
+/// shares the reader, nothing is decoded up front
+std::unique_ptr<ResourceCache> resource_cache_open(
+    std::shared_ptr<ZipReader> reader,
+    size_t budget = DEFAULT_RESOURCE_BUDGET
+);
+
+/// nullopt when the bundle has no file of that name
+std::optional<ResourceHandle>
+resource_open(ResourceCache& cache, std::string_view name);
+
+/// decodes the entry unless it is cached, nullopt when it fails to decode or
+/// does not match its CRC-32
+///
+/// stored entries point into the archive, they are checked on their first
+/// get only
+///
+/// entries larger than the whole budget are decoded once into a disk backed
+/// scratch file and mapped instead of being held in memory
+std::optional<Resource> resource_get(const ResourceHandle& handle);
+
+/// drops every cached entry, resources handed out stay valid
+void resource_cache_clear(ResourceCache& cache);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_RESOURCE_CACHE_HPP
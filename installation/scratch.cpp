@@ -0,0 +1,228 @@
+#include "scratch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <string>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#endif
+
+namespace encoding {
+
+namespace fs = std::filesystem;
+
+#if defined(_WIN32)
+
+static HANDLE scratch_handle(const ScratchFile& file) {
+    return reinterpret_cast<HANDLE>(file.handle);
+}
+
+ScratchFile::ScratchFile()
+    : handle(reinterpret_cast<intptr_t>(INVALID_HANDLE_VALUE)), size(0) {}
+
+ScratchFile::~ScratchFile() {
+    if (scratch_handle(*this) != INVALID_HANDLE_VALUE)
+        CloseHandle(scratch_handle(*this));
+}
+
+// windows has no unnamed files, the name is gone with the last handle, which
+// the kernel closes for a crashed process as well, and temporary files stay
+// in the cache as long as memory allows
+std::unique_ptr<ScratchFile> scratch_create(ScratchBacking backing) {
+    static std::atomic<uint32_t> counter{0};
+    std::error_code ec;
+    auto directory = fs::temp_directory_path(ec);
+    if (ec)
+        return nullptr;
+
+    DWORD attributes = FILE_FLAG_DELETE_ON_CLOSE;
+    if (backing == ScratchBacking::MEMORY)
+        attributes |= FILE_ATTRIBUTE_TEMPORARY;
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        auto path = directory / ("konduit-scratch-" +
+                                 std::to_string(GetCurrentProcessId()) + "-" +
+                                 std::to_string(counter++));
+        HANDLE handle = CreateFileW(
+            path.c_str(),
+            GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_DELETE,
+            nullptr,
+            CREATE_NEW,
+            attributes,
+            nullptr
+        );
+        if (handle != INVALID_HANDLE_VALUE) {
+            auto file = std::make_unique<ScratchFile>();
+            file->handle = reinterpret_cast<intptr_t>(handle);
+            return file;
+        }
+        if (GetLastError() != ERROR_FILE_EXISTS)
+            return nullptr;
+    }
+    return nullptr;
+}
+
+bool scratch_append(ScratchFile& file, std::span<const uint8_t> data) {
+    while (!data.empty()) {
+        OVERLAPPED at{};
+        at.Offset = static_cast<DWORD>(file.size);
+        at.OffsetHigh = static_cast<DWORD>(file.size >> 32);
+        DWORD chunk = static_cast<DWORD>(
+            std::min<size_t>(data.size(), 1u << 30)
+        );
+        DWORD written = 0;
+        if (!WriteFile(
+                scratch_handle(file), data.data(), chunk, &written, &at
+            ) ||
+            written == 0) {
+            return false;
+        }
+        file.size += written;
+        data = data.subspan(written);
+    }
+    return true;
+}
+
+std::unique_ptr<MappedFile> scratch_map(const ScratchFile& file) {
+    if (file.size == 0)
+        return nullptr;
+    HANDLE mapping = CreateFileMappingW(
+        scratch_handle(file),
+        nullptr,
+        PAGE_READONLY,
+        static_cast<DWORD>(file.size >> 32),
+        static_cast<DWORD>(file.size),
+        nullptr
+    );
+    if (!mapping)
+        return nullptr;
+    // the view keeps the mapping object and with it the file alive
+    void* view = MapViewOfFile(
+        mapping, FILE_MAP_READ, 0, 0, static_cast<size_t>(file.size)
+    );
+    CloseHandle(mapping);
+    if (!view)
+        return nullptr;
+
+    auto mapped = std::make_unique<MappedFile>();
+    mapped->view = static_cast<const uint8_t*>(view);
+    mapped->view_size = static_cast<size_t>(file.size);
+    mapped->data = mapped->view;
+    mapped->size = mapped->view_size;
+    return mapped;
+}
+
+#else
+
+ScratchFile::ScratchFile() : handle(-1), size(0) {}
+
+ScratchFile::~ScratchFile() {
+    if (handle >= 0)
+        close(static_cast<int>(handle));
+}
+
+// a named file that is unlinked before anyone else could use it, where the
+// kernel cannot create unnamed ones
+static int unlinked_temp_file(const fs::path& directory) {
+    std::string path = (directory / "konduit-scratch-XXXXXX").string();
+    int fd = mkstemp(path.data());
+    if (fd < 0)
+        return -1;
+    unlink(path.c_str());
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+static int disk_scratch() {
+    std::error_code ec;
+    auto directory = fs::temp_directory_path(ec);
+    if (ec)
+        return -1;
+#if defined(O_TMPFILE)
+    int fd = open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    // filesystems without O_TMPFILE support fail with EOPNOTSUPP, kernels
+    // older than 3.11 with EISDIR
+    if (fd >= 0 || (errno != EOPNOTSUPP && errno != EISDIR))
+        return fd;
+#endif
+    return unlinked_temp_file(directory);
+}
+
+std::unique_ptr<ScratchFile> scratch_create(ScratchBacking backing) {
+    int fd = -1;
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    if (backing == ScratchBacking::MEMORY)
+        fd = memfd_create("konduit-scratch", MFD_CLOEXEC);
+#else
+    (void)backing;
+#endif
+    if (fd < 0)
+        fd = disk_scratch();
+    if (fd < 0)
+        return nullptr;
+
+    auto file = std::make_unique<ScratchFile>();
+    file->handle = fd;
+    return file;
+}
+
+bool scratch_append(ScratchFile& file, std::span<const uint8_t> data) {
+    int fd = static_cast<int>(file.handle);
+    while (!data.empty()) {
+        ssize_t written = pwrite(
+            fd, data.data(), data.size(), static_cast<off_t>(file.size)
+        );
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        file.size += static_cast<uint64_t>(written);
+        data = data.subspan(static_cast<size_t>(written));
+    }
+    return true;
+}
+
+std::unique_ptr<MappedFile> scratch_map(const ScratchFile& file) {
+    if (file.size == 0)
+        return nullptr;
+    // shared, so the pages are the file's own and not copied on a fault
+    void* view = mmap(
+        nullptr,
+        static_cast<size_t>(file.size),
+        PROT_READ,
+        MAP_SHARED,
+        static_cast<int>(file.handle),
+        0
+    );
+    if (view == MAP_FAILED)
+        return nullptr;
+
+    auto mapped = std::make_unique<MappedFile>();
+    mapped->view = static_cast<const uint8_t*>(view);
+    mapped->view_size = static_cast<size_t>(file.size);
+    mapped->data = mapped->view;
+    mapped->size = mapped->view_size;
+    return mapped;
+}
+
+#endif
+
+std::unique_ptr<ScratchFile>
+scratch_from_buffer(std::span<const uint8_t> data, ScratchBacking backing) {
+    auto file = scratch_create(backing);
+    if (!file || !scratch_append(*file, data))
+        return nullptr;
+    return file;
+}
+
+}  // namespace encoding
@@ -0,0 +1,61 @@
+#ifndef KONDUIT_INSTALLER_SCRATCH_HPP
+#define KONDUIT_INSTALLER_SCRATCH_HPP
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include "mapped_file.hpp"
+
+namespace encoding {
+
+/// where a scratch file keeps its pages
+enum class ScratchBacking : uint8_t {
+    /// memfd_create on linux, memory that is swapped out under pressure
+    MEMORY,
+    /// an O_TMPFILE in the temp directory on linux, for data too large to
+    /// keep in memory
+    DISK,
+};
+
+/// anonymous file for data needed only while the installer runs, it never
+/// gets a name in a directory and the kernel reclaims it once its last
+/// descriptor and mapping are gone, after a crash too
+///
+/// linux uses memfd_create or O_TMPFILE, other unix systems unlink a mkstemp
+/// file right away and windows opens it delete on close
+///
+/// kept free of platform headers like MappedFile
+struct ScratchFile {
+    /// the file descriptor, a HANDLE on windows
+    intptr_t handle;
+    /// bytes appended so far
+    uint64_t size;
+
+    ScratchFile();
+    ~ScratchFile();
+    ScratchFile(const ScratchFile&) = delete;
+    ScratchFile& operator=(const ScratchFile&) = delete;
+};
+
+/// an empty scratch file, nullptr when none could be created, memory backed
+/// ones fall back to disk where memfd_create is missing
+std::unique_ptr<ScratchFile>
+scratch_create(ScratchBacking backing = ScratchBacking::MEMORY);
+
+/// writes `data` to the end of the file
+bool scratch_append(ScratchFile& file, std::span<const uint8_t> data);
+
+/// a scratch file holding `data`, for consumers that need a descriptor
+std::unique_ptr<ScratchFile> scratch_from_buffer(
+    std::span<const uint8_t> data,
+    ScratchBacking backing = ScratchBacking::MEMORY
+);
+
+/// maps everything appended so far without copying it, the mapping stays
+/// valid after the scratch file is closed and keeps its pages alive, nullptr
+/// for an empty file
+std::unique_ptr<MappedFile> scratch_map(const ScratchFile& file);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_SCRATCH_HPP
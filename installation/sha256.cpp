@@ -0,0 +1,280 @@
+#include "sha256.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KONDUIT_SHA256_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace encoding {
+
+alignas(16) static const uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+using BlockFunction = void (*)(uint32_t*, const uint8_t*, size_t);
+
+static uint32_t rotate_right(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static uint32_t load_be32(const uint8_t* p) {
+    return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) |
+           (uint32_t{p[2]} << 8) | uint32_t{p[3]};
+}
+
+static void sha256_blocks_portable(
+    uint32_t* state,
+    const uint8_t* data,
+    size_t blocks
+) {
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = load_be32(data + i * 4);
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotate_right(w[i - 15], 7) ^
+                          rotate_right(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotate_right(w[i - 2], 17) ^
+                          rotate_right(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t s1 = rotate_right(e, 6) ^ rotate_right(e, 11) ^
+                          rotate_right(e, 25);
+            uint32_t choice = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + choice + ROUND_CONSTANTS[i] + w[i];
+            uint32_t s0 = rotate_right(a, 2) ^ rotate_right(a, 13) ^
+                          rotate_right(a, 22);
+            uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + majority;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if defined(KONDUIT_SHA256_X86)
+
+#if defined(_MSC_VER)
+#define KONDUIT_TARGET_SHA
+#else
+#define KONDUIT_TARGET_SHA __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+
+// the SHA extensions keep the state as ABEF/CDGH pairs and run two rounds
+// per sha256rnds2, the message schedule for the next four words comes out
+// of sha256msg1/sha256msg2
+KONDUIT_TARGET_SHA static void
+sha256_blocks_shani(uint32_t* state, const uint8_t* data, size_t blocks) {
+    const __m128i byte_swap =
+        _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i cdab = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+    __m128i efgh =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+    cdab = _mm_shuffle_epi32(cdab, 0xb1);
+    efgh = _mm_shuffle_epi32(efgh, 0x1b);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i abef_saved = abef;
+        __m128i cdgh_saved = cdgh;
+
+        __m128i words[4];
+        for (int i = 0; i < 4; ++i) {
+            words[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(data + i * 16)
+                ),
+                byte_swap
+            );
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            __m128i k = _mm_load_si128(
+                reinterpret_cast<const __m128i*>(ROUND_CONSTANTS + i * 4)
+            );
+            __m128i wk = _mm_add_epi32(words[i % 4], k);
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+            abef = _mm_sha256rnds2_epu32(
+                abef, cdgh, _mm_shuffle_epi32(wk, 0x0e)
+            );
+
+            // words i+4 replace words i, which are not needed anymore
+            if (i < 12) {
+                __m128i next =
+                    _mm_sha256msg1_epu32(words[i % 4], words[(i + 1) % 4]);
+                next = _mm_add_epi32(
+                    next,
+                    _mm_alignr_epi8(words[(i + 3) % 4], words[(i + 2) % 4], 4)
+                );
+                words[i % 4] = _mm_sha256msg2_epu32(next, words[(i + 3) % 4]);
+            }
+        }
+
+        abef = _mm_add_epi32(abef, abef_saved);
+        cdgh = _mm_add_epi32(cdgh, cdgh_saved);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xf0)
+    );
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8)
+    );
+}
+
+static bool has_sha_extensions() {
+    // leaf 7 ebx bit 29 is SHA, leaf 1 ecx bits 9 and 19 are SSSE3 and SSE4.1
+    constexpr unsigned SHA_BIT = 1u << 29;
+    constexpr unsigned SSSE3_BIT = 1u << 9;
+    constexpr unsigned SSE41_BIT = 1u << 19;
+    unsigned ebx7 = 0, ecx1 = 0;
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+        return false;
+    __cpuidex(regs, 7, 0);
+    ebx7 = static_cast<unsigned>(regs[1]);
+    __cpuid(regs, 1);
+    ecx1 = static_cast<unsigned>(regs[2]);
+#else
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return false;
+    ebx7 = ebx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    ecx1 = ecx;
+#endif
+    return (ebx7 & SHA_BIT) && (ecx1 & SSSE3_BIT) && (ecx1 & SSE41_BIT);
+}
+
+#endif
+
+static BlockFunction sha256_blocks() {
+    static const BlockFunction blocks = []() -> BlockFunction {
+#if defined(KONDUIT_SHA256_X86)
+        if (has_sha_extensions())
+            return sha256_blocks_shani;
+#endif
+        return sha256_blocks_portable;
+    }();
+    return blocks;
+}
+
+Sha256::Sha256()
+    : state{
+          0x6a09e667,
+          0xbb67ae85,
+          0x3c6ef372,
+          0xa54ff53a,
+          0x510e527f,
+          0x9b05688c,
+          0x1f83d9ab,
+          0x5be0cd19
+      },
+      length(0),
+      buffer{},
+      buffered(0) {}
+
+void sha256_update(Sha256& sha, const uint8_t* data, size_t size) {
+    if (size == 0)
+        return;
+    auto blocks = sha256_blocks();
+    sha.length += size;
+
+    if (sha.buffered > 0) {
+        size_t take = std::min(size, sizeof(sha.buffer) - sha.buffered);
+        std::memcpy(sha.buffer + sha.buffered, data, take);
+        sha.buffered += take;
+        data += take;
+        size -= take;
+        if (sha.buffered < sizeof(sha.buffer))
+            return;
+        blocks(sha.state, sha.buffer, 1);
+        sha.buffered = 0;
+    }
+
+    // whole blocks straight from the input
+    if (size >= 64) {
+        blocks(sha.state, data, size / 64);
+        data += size & ~size_t{63};
+        size &= 63;
+    }
+
+    if (size > 0) {
+        std::memcpy(sha.buffer, data, size);
+        sha.buffered = size;
+    }
+}
+
+Sha256Digest sha256_finish(Sha256& sha) {
+    uint64_t bits = sha.length * 8;
+    uint8_t padding[72] = {0x80};
+    size_t padding_size =
+        (sha.buffered < 56 ? 56 : 120) - sha.buffered;
+    for (int i = 0; i < 8; ++i) {
+        padding[padding_size + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    uint64_t length = sha.length;
+    sha256_update(sha, padding, padding_size + 8);
+    sha.length = length;
+
+    Sha256Digest digest;
+    for (int i = 0; i < 8; ++i) {
+        digest[i * 4 + 0] = static_cast<uint8_t>(sha.state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(sha.state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(sha.state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(sha.state[i]);
+    }
+    return digest;
+}
+
+Sha256Digest sha256(const uint8_t* data, size_t size) {
+    Sha256 sha;
+    sha256_update(sha, data, size);
+    return sha256_finish(sha);
+}
+
+}  // namespace encoding
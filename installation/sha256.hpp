@@ -0,0 +1,31 @@
+#ifndef KONDUIT_INSTALLER_SHA256_HPP
+#define KONDUIT_INSTALLER_SHA256_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// kept free of raylib so the bundle builder can share it with the installer
+
+namespace encoding {
+
+using Sha256Digest = std::array<uint8_t, 32>;
+
+/// incremental SHA-256, uses the x86 SHA extensions when the cpu has them
+struct Sha256 {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t buffer[64];
+    size_t buffered;
+
+    Sha256();
+};
+
+void sha256_update(Sha256& sha, const uint8_t* data, size_t size);
+Sha256Digest sha256_finish(Sha256& sha);
+
+Sha256Digest sha256(const uint8_t* data, size_t size);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_SHA256_HPP
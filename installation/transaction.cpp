@@ -0,0 +1,464 @@
+#include "transaction.hpp"
+
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <set>
+#include <string_view>
+#include "file_writer.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <cstdio>
+#endif
+
+namespace encoding {
+
+namespace fs = std::filesystem;
+
+// the journal has one line per directory the publish creates, "d <name>",
+// and one per staged file, "f <replaces> <device hex> <inode hex> <name>",
+// names run to the end of the line like in the manifest
+
+static fs::path staging_root(const fs::path& install_path) {
+    return install_path / STAGING_NAME;
+}
+
+fs::path staging_path(const fs::path& install_path) {
+    return staging_root(install_path) / "files";
+}
+
+// installed files a publish without RENAME_EXCHANGE moved out of the way,
+// kept until the install is committed
+static fs::path replaced_path(const fs::path& install_path) {
+    return staging_root(install_path) / "replaced";
+}
+
+static fs::path journal_path(const fs::path& install_path) {
+    return install_path / JOURNAL_NAME;
+}
+
+std::optional<FileIdentity> file_identity(const fs::path& path) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(
+        path.c_str(),
+        0,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT,
+        nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE)
+        return std::nullopt;
+    BY_HANDLE_FILE_INFORMATION information;
+    bool ok = GetFileInformationByHandle(file, &information);
+    CloseHandle(file);
+    if (!ok)
+        return std::nullopt;
+    return FileIdentity{
+        information.dwVolumeSerialNumber,
+        (uint64_t{information.nFileIndexHigh} << 32) |
+            information.nFileIndexLow
+    };
+#else
+    struct stat status;
+    if (lstat(path.c_str(), &status) != 0)
+        return std::nullopt;
+    return FileIdentity{
+        static_cast<uint64_t>(status.st_dev),
+        static_cast<uint64_t>(status.st_ino)
+    };
+#endif
+}
+
+bool has_interrupted_install(const fs::path& install_path) {
+    std::error_code ec;
+    return fs::exists(staging_root(install_path), ec) ||
+           fs::exists(journal_path(install_path), ec);
+}
+
+bool write_journal(const fs::path& install_path, const Journal& journal) {
+    auto path = journal_path(install_path);
+    auto temp = path;
+    temp += ".tmp";
+    std::error_code ec;
+
+    {
+        std::ofstream file(temp, std::ios::trunc);
+        for (const auto& directory : journal.directories) {
+            file << std::format("d {}\n", directory);
+        }
+        for (const auto& entry : journal.files) {
+            file << std::format(
+                "f {:d} {:x} {:x} {}\n",
+                entry.replaces,
+                entry.staged.device,
+                entry.staged.inode,
+                entry.name
+            );
+        }
+        file.close();
+        if (file.fail()) {
+            fs::remove(temp, ec);
+            return false;
+        }
+    }
+
+    if (!sync_file(temp)) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    fs::rename(temp, path, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    return sync_directory(install_path);
+}
+
+// splits off the next space separated field of `line`
+static std::optional<std::string_view> next_field(std::string_view& line) {
+    auto end = line.find(' ');
+    if (end == std::string_view::npos)
+        return std::nullopt;
+    auto field = line.substr(0, end);
+    line.remove_prefix(end + 1);
+    return field;
+}
+
+template <typename T>
+static bool parse_number(std::string_view field, T& value, int base) {
+    auto parsed =
+        std::from_chars(field.data(), field.data() + field.size(), value, base);
+    return parsed.ec == std::errc() &&
+           parsed.ptr == field.data() + field.size();
+}
+
+static std::optional<JournalEntry> parse_file_line(std::string_view line) {
+    auto replaces = next_field(line);
+    auto device = next_field(line);
+    auto inode = next_field(line);
+    if (!inode || line.empty())
+        return std::nullopt;
+
+    JournalEntry entry;
+    int replaced = 0;
+    if (!parse_number(*replaces, replaced, 10) ||
+        !parse_number(*device, entry.staged.device, 16) ||
+        !parse_number(*inode, entry.staged.inode, 16)) {
+        return std::nullopt;
+    }
+    entry.replaces = replaced != 0;
+    entry.name = line;
+    return entry;
+}
+
+std::optional<Journal> read_journal(const fs::path& install_path) {
+    std::ifstream file(journal_path(install_path));
+    if (!file)
+        return std::nullopt;
+
+    Journal journal;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string_view rest = line;
+        if (rest.starts_with("d ") && rest.size() > 2) {
+            journal.directories.emplace_back(rest.substr(2));
+        } else if (rest.starts_with("f ")) {
+            auto entry = parse_file_line(rest.substr(2));
+            if (!entry)
+                return std::nullopt;
+            journal.files.push_back(std::move(*entry));
+        } else if (!rest.empty()) {
+            return std::nullopt;
+        }
+    }
+    return journal;
+}
+
+// makes the renames of a publish or rollback durable, with one syncfs or by
+// flushing every directory they touched once
+static bool
+sync_published(const fs::path& install_path, const Journal& journal) {
+    if (sync_filesystem(install_path))
+        return true;
+
+    std::error_code ec;
+    auto staging = staging_path(install_path);
+    std::set<fs::path> directories{install_path};
+    for (const auto& entry : journal.files) {
+        directories.insert((install_path / entry.name).parent_path());
+        directories.insert((staging / entry.name).parent_path());
+        directories.insert(
+            (replaced_path(install_path) / entry.name).parent_path()
+        );
+    }
+    for (const auto& directory : journal.directories) {
+        directories.insert((install_path / directory).parent_path());
+    }
+
+    bool ok = true;
+    for (const auto& directory : directories) {
+        // never created, or removed again by a rollback, which its parent
+        // records
+        if (!fs::is_directory(directory, ec))
+            continue;
+        ok = sync_directory(directory) && ok;
+    }
+    return ok;
+}
+
+// undoes the publish of one file, whatever step it got to
+static bool
+rollback_file(const fs::path& install_path, const JournalEntry& entry) {
+    auto target = install_path / entry.name;
+    auto staged = staging_path(install_path) / entry.name;
+    auto saved = replaced_path(install_path) / entry.name;
+    std::error_code ec;
+
+    auto identity = file_identity(target);
+    if (identity && *identity == entry.staged) {
+        if (!entry.replaces) {
+            fs::remove(target, ec);
+            return !ec;
+        }
+        // an exchange left the installed file at the staged name, the
+        // fallback at the replaced one
+        auto installed = fs::exists(fs::symlink_status(staged, ec)) ? staged
+                                                                     : saved;
+        fs::rename(installed, target, ec);
+        return !ec;
+    }
+    if (!identity && entry.replaces &&
+        fs::exists(fs::symlink_status(saved, ec))) {
+        // moved out of the way, but the staged file never took its place
+        fs::rename(saved, target, ec);
+        return !ec;
+    }
+    return true;
+}
+
+static bool rollback(const fs::path& install_path, const Journal& journal) {
+    bool ok = true;
+    for (auto it = journal.files.rbegin(); it != journal.files.rend(); ++it) {
+        ok = rollback_file(install_path, *it) && ok;
+    }
+    // children first, a directory still holding something stays
+    std::error_code ec;
+    for (auto it = journal.directories.rbegin();
+         it != journal.directories.rend();
+         ++it) {
+        fs::remove(install_path / *it, ec);
+    }
+    return sync_published(install_path, journal) && ok;
+}
+
+bool recover_install(const fs::path& install_path) {
+    std::error_code ec;
+    auto path = journal_path(install_path);
+    if (fs::exists(path, ec)) {
+        auto journal = read_journal(install_path);
+        if (!journal || !rollback(install_path, *journal))
+            return false;
+        fs::remove(path, ec);
+        if (ec)
+            return false;
+        sync_directory(install_path);
+    }
+    // a crash while the journal was written, nothing was published yet
+    auto temp = path;
+    temp += ".tmp";
+    fs::remove(temp, ec);
+    fs::remove_all(staging_root(install_path), ec);
+    return !ec;
+}
+
+// makes the staged files durable before the journal names them, every file
+// and then every directory is flushed where there is no syncfs
+static bool sync_staged(const fs::path& install_path) {
+    auto staging = staging_path(install_path);
+    if (sync_filesystem(staging))
+        return true;
+
+    bool ok = true;
+    std::error_code ec;
+    std::vector<fs::path> directories{staging};
+    for (auto it = fs::recursive_directory_iterator(staging, ec);
+         !ec && it != fs::recursive_directory_iterator();
+         it.increment(ec)) {
+        std::error_code type_ec;
+        if (it->is_directory(type_ec)) {
+            directories.push_back(it->path());
+        } else if (it->is_regular_file(type_ec)) {
+            ok = sync_file(it->path()) && ok;
+        }
+    }
+    // the entries of a directory only after the files they name
+    for (const auto& directory : directories) {
+        ok = sync_directory(directory) && ok;
+    }
+    return ok && !ec;
+}
+
+static bool exchange_files(const fs::path& staged, const fs::path& target) {
+#if defined(__linux__) && defined(RENAME_EXCHANGE)
+    return renameat2(
+               AT_FDCWD,
+               staged.c_str(),
+               AT_FDCWD,
+               target.c_str(),
+               RENAME_EXCHANGE
+           ) == 0;
+#else
+    (void)staged;
+    (void)target;
+    return false;
+#endif
+}
+
+static bool
+publish_file(const fs::path& install_path, const JournalEntry& entry) {
+    auto target = install_path / entry.name;
+    auto staged = staging_path(install_path) / entry.name;
+    std::error_code ec;
+    if (!entry.replaces) {
+        fs::rename(staged, target, ec);
+        return !ec;
+    }
+    if (exchange_files(staged, target))
+        return true;
+
+    // a hardlink keeps the installed file in place until the rename replaces
+    // it, without hardlinks it is briefly missing
+    auto saved = replaced_path(install_path) / entry.name;
+    fs::create_directories(saved.parent_path(), ec);
+    fs::create_hard_link(target, saved, ec);
+    if (ec) {
+        fs::rename(target, saved, ec);
+        if (ec)
+            return false;
+    }
+    fs::rename(staged, target, ec);
+    return !ec;
+}
+
+// lists what the publish is going to change, fails when a file is in the way
+// of a directory or the other way around
+static bool plan_publish(
+    const fs::path& install_path,
+    Journal& journal,
+    std::string& failure
+) {
+    auto staging = staging_path(install_path);
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(staging, ec);
+         !ec && it != fs::recursive_directory_iterator();
+         it.increment(ec)) {
+        auto name = it->path().lexically_relative(staging).generic_string();
+        auto target = install_path / name;
+        std::error_code status_ec;
+        auto status = fs::symlink_status(target, status_ec);
+        if (it->is_directory(status_ec)) {
+            if (fs::is_directory(status))
+                continue;
+            if (fs::exists(status)) {
+                failure = std::format("{} is in the way", target.string());
+                return false;
+            }
+            journal.directories.push_back(std::move(name));
+            continue;
+        }
+
+        auto identity = file_identity(it->path());
+        if (!identity) {
+            failure = std::format("failed to stat {}", it->path().string());
+            return false;
+        }
+        if (fs::is_directory(status)) {
+            failure = std::format("{} is in the way", target.string());
+            return false;
+        }
+        journal.files.push_back(
+            {std::move(name), *identity, fs::exists(status)}
+        );
+    }
+    if (ec) {
+        failure = std::format("failed to list staged files: {}", ec.message());
+        return false;
+    }
+    return true;
+}
+
+bool publish_staged(const fs::path& install_path, std::string& failure) {
+    Journal journal;
+    if (!sync_staged(install_path)) {
+        failure = "failed to flush the staged files";
+        discard_staged(install_path);
+        return false;
+    }
+    if (!plan_publish(install_path, journal, failure)) {
+        discard_staged(install_path);
+        return false;
+    }
+    if (!write_journal(install_path, journal)) {
+        failure = "failed to write the install journal";
+        discard_staged(install_path);
+        return false;
+    }
+
+    bool ok = true;
+    std::error_code ec;
+    for (const auto& directory : journal.directories) {
+        fs::create_directory(install_path / directory, ec);
+        if (ec) {
+            failure = std::format(
+                "failed to create {}: {}", directory, ec.message()
+            );
+            ok = false;
+            break;
+        }
+    }
+    for (size_t i = 0; ok && i < journal.files.size(); ++i) {
+        if (!publish_file(install_path, journal.files[i])) {
+            failure = std::format(
+                "failed to move {} into place", journal.files[i].name
+            );
+            ok = false;
+        }
+    }
+    if (ok && !sync_published(install_path, journal)) {
+        failure = "failed to flush the installed files";
+        ok = false;
+    }
+    // the journal stays for the next start when even the rollback fails
+    if (!ok && !rollback(install_path, journal)) {
+        failure += ", rolling back failed too";
+        return false;
+    }
+
+    // removing the journal commits the install, or confirms the rollback,
+    // one left behind is rolled back by the next recover_install
+    fs::remove(journal_path(install_path), ec);
+    if (ec) {
+        failure = std::format(
+            "failed to remove the install journal: {}", ec.message()
+        );
+        return false;
+    }
+    sync_directory(install_path);
+    discard_staged(install_path);
+    return ok;
+}
+
+void discard_staged(const fs::path& install_path) {
+    std::error_code ec;
+    fs::remove_all(staging_root(install_path), ec);
+}
+
+}  // namespace encoding
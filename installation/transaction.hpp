@@ -0,0 +1,86 @@
+#ifndef KONDUIT_INSTALLER_TRANSACTION_HPP
+#define KONDUIT_INSTALLER_TRANSACTION_HPP
+
+#include <compare>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// kept free of raylib like mapped_file.hpp so the windows file index can be
+// read without clashing with raylib names, the caller logs what failed
+
+namespace encoding {
+
+/// hidden directory below the install path a transactional install writes
+/// to, on the same filesystem so its files can be renamed into place
+constexpr const char* STAGING_NAME = ".konduit-staging";
+/// lists the files being moved into place, it only exists while they are,
+/// removing it commits the install
+constexpr const char* JOURNAL_NAME = ".konduit-journal";
+
+/// device and inode (volume and file index on windows), tells whether a path
+/// still names the file that was staged
+struct FileIdentity {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+
+    auto operator<=>(const FileIdentity&) const = default;
+};
+
+std::optional<FileIdentity> file_identity(const std::filesystem::path& path);
+
+struct JournalEntry {
+    /// relative to the install path
+    std::string name;
+    /// the staged file, a crash left it published when the name has it
+    FileIdentity staged;
+    /// an installed file was in the way, it is moved back on rollback
+    bool replaces = false;
+};
+
+struct Journal {
+    std::vector<JournalEntry> files;
+    /// created by the publish, parents first, removed again on rollback
+    std::vector<std::string> directories;
+};
+
+/// where the files of the next transactional install are staged
+std::filesystem::path staging_path(const std::filesystem::path& install_path);
+
+/// a crash left staged files or a journal behind
+bool has_interrupted_install(const std::filesystem::path& install_path);
+
+/// writes the journal next to a temporary name, flushes it and renames it
+/// into place, the rename is what makes it count
+bool write_journal(
+    const std::filesystem::path& install_path,
+    const Journal& journal
+);
+
+std::optional<Journal> read_journal(const std::filesystem::path& install_path);
+
+/// puts back what a journal says was published and clears the staging
+/// directory, run before every transactional install, true when nothing
+/// was left or everything could be undone
+bool recover_install(const std::filesystem::path& install_path);
+
+/// flushes the staged files, with one syncfs where linux has it, then moves
+/// them into place behind a journal that is removed once the moves are
+/// durable, an installed file is exchanged with its replacement through
+/// renameat2(RENAME_EXCHANGE) where supported
+///
+/// on failure everything already moved is rolled back and `failure` names
+/// what went wrong, the staging directory is cleared either way
+bool publish_staged(
+    const std::filesystem::path& install_path,
+    std::string& failure
+);
+
+/// drops a transaction that is not going to be published
+void discard_staged(const std::filesystem::path& install_path);
+
+}  // namespace encoding
+
+#endif  // KONDUIT_INSTALLER_TRANSACTION_HPP
@@ -1,5 +1,9 @@
 #include "main.hpp"
+#include "embedded.hpp"
 #include "include/raylib/clay_renderer_raylib.h"
+#include "installation/install_job.hpp"
+#include "installation/payload.hpp"
+#include "installation/resource_cache.hpp"
 #include "ui/components.hpp"
 
 ClayMan* g_clayManInstance = nullptr;
@@ -23,24 +27,49 @@ unsigned int window_flags = FLAG_WINDOW_HIGHDPI | FLAG_MSAA_4X_HINT |
 Image logo_img;
 Texture2D logo;
 
+uint64_t required_install_bytes(const std::string& path);
+
 struct Install_data {
     std::string input_buffer;
     std::string install_path;
     void set_install_path(const std::string& path) {
-        validation = validate_path(path);
+        validation = validate_path(path, required_install_bytes(path));
         install_path = path;
     }
     DirectoryValidationResult validation;
-    bool test_toggle = false;
 
-    bool radio_test1 = false;
-    bool radio_test2 = false;
+    /// appended to the executable by konduit_append, keeps `bundles` valid
+    std::unique_ptr<encoding::AppendedPayload> appended;
+    std::vector<encoding::PayloadBundle> bundles;
+    /// in the order of `bundles`, opened the first time a bundle is needed
+    /// and shared by the free space check, the installs and the resources
+    std::vector<std::shared_ptr<encoding::ZipReader>> bundle_readers;
+    /// files of the core bundle decoded on demand, only the license so far
+    std::unique_ptr<encoding::ResourceCache> core_resources;
+    std::optional<encoding::ResourceHandle> license;
+    std::string license_text;
+    bool show_license = false;
+
+    /// a bundle that is only installed when it was selected
+    struct OptionalComponent {
+        const encoding::PayloadBundle* bundle;
+        bool selected = true;
+    };
+    std::vector<OptionalComponent> optional_components;
+    bool install_everything = true;
+    bool install_core_only = false;
+    bool install_custom = false;
 
     std::string temp_path;
 
     bool show_popup = false;
 
     std::string popup_input_buffer;
+
+    std::unique_ptr<encoding::InstallJob> install;
+    bool installing() const {
+        return install && encoding::install_running(*install);
+    }
 } data;
 
 void drag() {
@@ -105,6 +134,236 @@ void debug_ui() {
     );
 }
 
+// built next to the bundle by konduit_pack, an install without them still
+// runs but is only checked against the crc32 of every entry
+std::optional<encoding::DigestManifest>
+bundle_digests(const encoding::PayloadBundle& bundle) {
+    const auto& text = bundle.digests;
+    if (text.empty())
+        return std::nullopt;
+    auto digests = encoding::parse_digests(
+        {reinterpret_cast<const char*>(text.data()), text.size()}
+    );
+    if (!digests)
+        error("The embedded digests are corrupt, skipping verification");
+    return digests;
+}
+
+// generate_embed_files.cmake compresses the ui assets with KONDUIT_ASSET_CODEC,
+// raylib copies what it needs out of the decoded bytes so one buffer is enough
+std::span<const uint8_t>
+embedded_asset(const EmbeddedFile& asset, encoding::EmbeddedBuffer& buffer) {
+    auto bytes = encoding::decode_embedded(
+        embedded_bytes(asset), *asset.uncompressed_size, *asset.codec, buffer
+    );
+    if (!bytes) {
+        error(
+            std::format("The embedded asset {} is corrupt", asset.name).c_str()
+        );
+        return {};
+    }
+    return *bytes;
+}
+
+// indexes the bundle's entries the first time it is needed
+const std::shared_ptr<encoding::ZipReader>& bundle_reader(size_t i) {
+    auto& reader = data.bundle_readers[i];
+    if (!reader) {
+        reader = encoding::zip_init_from_buffer(
+            data.bundles[i].data.data(), data.bundles[i].data.size()
+        );
+    }
+    return reader;
+}
+
+// bundles appended by konduit_append take the place of #embedded ones, the
+// installer is built without any in that mode
+void find_bundles() {
+    if (auto executable = encoding::self_executable_path())
+        data.appended = encoding::open_appended_payload(*executable);
+    if (data.appended) {
+        data.bundles = data.appended->bundles;
+        info(
+            std::format(
+                "Found {} bundles appended to the installer",
+                data.bundles.size()
+            )
+                .c_str()
+        );
+    } else {
+        for (const auto& file : EMBEDDED_FILES) {
+            if (file.kind == EmbeddedKind::BUNDLE) {
+                data.bundles.push_back(
+                    {file.component,
+                     file.name,
+                     embedded_bytes(file),
+                     embedded_digests(file)}
+                );
+            }
+        }
+    }
+
+    // every bundle besides the core one, in the order KONDUIT_BUNDLES lists
+    // them
+    for (const auto& bundle : data.bundles) {
+        if (bundle.component != encoding::CORE_COMPONENT)
+            data.optional_components.push_back({&bundle});
+    }
+    data.bundle_readers.resize(data.bundles.size());
+
+    // only looked up here, the license is decoded once it is opened
+    for (size_t i = 0; i < data.bundles.size(); ++i) {
+        if (data.bundles[i].component != encoding::CORE_COMPONENT)
+            continue;
+        data.core_resources = encoding::resource_cache_open(bundle_reader(i));
+        if (!data.core_resources)
+            break;
+        for (auto name : {"LICENSE", "LICENSE.txt", "LICENSE.md"}) {
+            data.license = encoding::resource_open(*data.core_resources, name);
+            if (data.license)
+                break;
+        }
+    }
+}
+
+bool component_selected(const encoding::PayloadBundle& bundle) {
+    if (bundle.component == encoding::CORE_COMPONENT || data.install_everything)
+        return true;
+    if (!data.install_custom)
+        return false;
+    return std::ranges::any_of(data.optional_components, [&](auto& component) {
+        return component.bundle == &bundle && component.selected;
+    });
+}
+
+// what the selected bundles write, summed straight from their entry tables,
+// an update only writes new and changed files, which are staged next to the
+// copies they replace until the install is committed
+uint64_t required_install_bytes(const std::string& path) {
+    uint64_t required = 0;
+    for (size_t i = 0; i < data.bundles.size(); ++i) {
+        const auto& bundle = data.bundles[i];
+        if (!component_selected(bundle))
+            continue;
+        const auto& reader = bundle_reader(i);
+        auto installed = encoding::read_manifest(path, bundle.component);
+        uint32_t count = encoding::zip_get_file_count(reader.get());
+        for (uint32_t e = 0; e < count; ++e) {
+            auto entry = encoding::zip_get_entry(reader.get(), e);
+            if (!entry || entry->is_directory)
+                continue;
+            if (installed) {
+                auto it = installed->find(entry->name);
+                if (it != installed->end() &&
+                    it->second.size == entry->uncompressed_size &&
+                    it->second.crc32 == entry->crc32) {
+                    continue;
+                }
+            }
+            required += entry->uncompressed_size;
+        }
+    }
+    return required;
+}
+
+// only the selected bundles get a reader, the others are never scanned or
+// decoded
+std::vector<encoding::InstallComponent> selected_components() {
+    std::vector<encoding::InstallComponent> components;
+    for (size_t i = 0; i < data.bundles.size(); ++i) {
+        const auto& bundle = data.bundles[i];
+        if (!component_selected(bundle))
+            continue;
+        components.push_back(
+            {std::string(bundle.component),
+             bundle_reader(i),
+             bundle_digests(bundle)}
+        );
+    }
+    return components;
+}
+
+void component_selection() {
+    if (data.optional_components.empty())
+        return;
+    bool changed = radio_selection(
+        "components",
+        {{"everything", &data.install_everything},
+         {"core only", &data.install_core_only},
+         {"custom", &data.install_custom}}
+    );
+    if (data.install_custom) {
+        for (auto& component : data.optional_components) {
+            changed |= checkbox(
+                std::string(component.bundle->component), &component.selected
+            );
+        }
+    }
+    // the free space needed follows the selection
+    if (changed && !data.install_path.empty())
+        data.set_install_path(data.install_path);
+}
+
+void install_status(const encoding::InstallJob& job) {
+    progress_bar(
+        encoding::install_fraction(job),
+        "install",
+        {static_cast<int>(job.progress.files_done),
+         static_cast<int>(job.progress.files_total)}
+    );
+
+    std::string status;
+    switch (job.state.load()) {
+        case encoding::InstallState::RUNNING:
+            status = job.progress.verifying
+                         ? "verifying installed files"
+                         : std::format(
+                               "installing {}",
+                               encoding::install_current_entry(job)
+                           );
+            if (job.components.size() > 1) {
+                status = std::format(
+                    "{} ({} of {}): {}",
+                    encoding::install_current_component(job),
+                    job.current_component + 1,
+                    job.components.size(),
+                    status
+                );
+            }
+            break;
+        case encoding::InstallState::DONE:
+            status = std::format(
+                "installation finished: {} written, {} unchanged, {} "
+                "removed{}",
+                job.result->extract.files_written +
+                    job.result->extract.files_linked,
+                job.result->extract.files_unchanged,
+                job.result->extract.files_removed,
+                job.result->verify ? ", all files verified" : ""
+            );
+            break;
+        case encoding::InstallState::FAILED:
+            status = job.result ? std::format(
+                                      "installation failed, {} files could "
+                                      "not be written or verified",
+                                      job.result->extract.failed.size()
+                                  )
+                                : "installation failed";
+            break;
+        case encoding::InstallState::CANCELLED:
+            status = "installation cancelled";
+            break;
+    }
+    clay.textElement(
+        status,
+        {.textColor = job.state.load() == encoding::InstallState::FAILED
+                          ? ERROR
+                          : K_WHITE,
+         .fontId = FONT_SIZE_18_ID,
+         .fontSize = 18}
+    );
+}
+
 void installer_ui() {
     clay.element(
         {.id = clay.hashID("installer_root"),
@@ -148,13 +407,10 @@ void installer_ui() {
                  .cornerRadius = {6, 6, 6, 6},
                  .border = {.color = BORDER_GRAY, .width = {1, 1, 1, 1}}},
                 [&] {
-                    progress_bar(fmod(GetTime(), 2.0) / 2.0, "progress_test");
-                    checkbox("toggle", &data.test_toggle);
-                    radio_selection(
-                        "one of these",
-                        {{"first", &data.radio_test1},
-                         {"second", &data.radio_test2}}
-                    );
+                    if (data.install) {
+                        install_status(*data.install);
+                    }
+                    component_selection();
                     clay.textElement(
                         std::format(
                             "Select directory: \"{}\"", data.install_path
@@ -167,12 +423,27 @@ void installer_ui() {
                         data.set_install_path(data.input_buffer);
                         data.input_buffer.clear();
                     }
+                    if (data.validation.existing_install) {
+                        clay.textElement(
+                            "an existing installation was found, only changed "
+                            "files will be updated",
+                            {.textColor = TEXT_GRAY,
+                             .fontId = FONT_SIZE_18_ID,
+                             .fontSize = 18}
+                        );
+                    }
                     if (!data.validation.usable) {
                         std::string reason;
-                        if (!data.validation.exists_and_is_dir) {
+                        if (!data.validation.enough_space) {
+                            reason =
+                                "there is not enough free space for the "
+                                "selected components";
+                        } else if (!data.validation.exists_and_is_dir) {
                             reason = "it does not exist or is not a directory";
                         } else if (!data.validation.empty_initially) {
-                            reason = "it is not empty";
+                            reason =
+                                "it is not empty and holds no previous "
+                                "installation";
                         } else {
                             reason = "unknown reason";
                         }
@@ -215,18 +486,70 @@ void installer_ui() {
                         {.id = clay.hashID("filler"),
                          .layout = {.sizing = clay.expandX()}}
                     );
+                    if (data.license && button("License")) {
+                        if (auto text = encoding::resource_get(*data.license)) {
+                            data.license_text.assign(
+                                text->bytes.begin(), text->bytes.end()
+                            );
+                            data.show_license = true;
+                        }
+                    }
                     if (button("Cancel")) {
-                        should_close = true;
+                        // a running install is stopped first, the window
+                        // closes on the next click
+                        if (data.installing()) {
+                            encoding::install_cancel(*data.install);
+                        } else {
+                            should_close = true;
+                        }
                     }
-                    if (button("Next")) {
-                        auto t = encoding::load_resource_from_memory(
-                            gxogupjw4amjyxv_data, gxogupjw4amjyxv_size
-                        );
-                        data.show_popup = true;
+                    if (button("Next") && !data.installing()) {
+                        // the directory may have changed since it was picked,
+                        // a finished install turns it into an update target
+                        if (!data.install_path.empty()) {
+                            data.set_install_path(data.install_path);
+                        }
+                        if (data.install_path.empty() ||
+                            !data.validation.usable) {
+                            data.show_popup = true;
+                        } else {
+                            // decoding and writing run on worker threads,
+                            // the frame loop only polls the job
+                            data.install = encoding::install_start(
+                                selected_components(),
+                                data.install_path,
+                                {.update = data.validation.existing_install,
+                                 .transactional = true}
+                            );
+                        }
                     }
                     popup("destination selection", &data.show_popup, [&] {
                         text_input("dummy input", &data.popup_input_buffer);
                     });
+                    popup("license", &data.show_license, [&] {
+                        clay.element(
+                            {.id = clay.hashID("license_text"),
+                             .layout =
+                                 {.sizing = clay.fixedSize(
+                                      GetScreenWidth() - 60,
+                                      GetScreenHeight() - 80
+                                  ),
+                                  .padding = clay.padAll(8)},
+                             .backgroundColor = SECONDARY_BG,
+                             .cornerRadius = {6, 6, 6, 6},
+                             .clip =
+                                 {.vertical = true,
+                                  .childOffset = Clay_GetScrollOffset()}},
+                            [&] {
+                                clay.textElement(
+                                    data.license_text,
+                                    {.textColor = K_WHITE,
+                                     .fontId = FONT_SIZE_18_ID,
+                                     .fontSize = 18}
+                                );
+                            }
+                        );
+                    });
                 }
             );
         }
@@ -277,20 +600,27 @@ int main() {
         window_flags
     );
 
+    encoding::EmbeddedBuffer asset_buffer;
+    auto roboto = embedded_asset(
+        embedded_file("Roboto-Regular.ttf"), asset_buffer
+    );
     fonts[0] = LoadFontFromMemory(
-        ".ttf", roboto_regular_data, roboto_regular_size, 24, nullptr, 400
+        ".ttf", roboto.data(), static_cast<int>(roboto.size()), 24, nullptr, 400
     );
     GenTextureMipmaps(&fonts[0].texture);
     SetTextureFilter(fonts[0].texture, TEXTURE_FILTER_TRILINEAR);
     fonts[1] = LoadFontFromMemory(
-        ".ttf", roboto_regular_data, roboto_regular_size, 18, nullptr, 400
+        ".ttf", roboto.data(), static_cast<int>(roboto.size()), 18, nullptr, 400
     );
     GenTextureMipmaps(&fonts[1].texture);
     SetTextureFilter(fonts[1].texture, TEXTURE_FILTER_TRILINEAR);
+    auto icons = embedded_asset(
+        embedded_file("fa-regular-400.ttf"), asset_buffer
+    );
     fonts[2] = LoadFontFromMemory(
         ".ttf",
-        fa_regular_400_data,
-        fa_regular_400_size,
+        icons.data(),
+        static_cast<int>(icons.size()),
         24,
         (int*)(icon_codepoints.data()),
         icon_codepoints.size()
@@ -298,8 +628,13 @@ int main() {
     GenTextureMipmaps(&fonts[2].texture);
     SetTextureFilter(fonts[2].texture, TEXTURE_FILTER_TRILINEAR);
 
-    logo_img =
-        LoadImageFromMemory(test_logo_ext, test_logo_data, test_logo_size);
+    find_bundles();
+
+    constexpr const EmbeddedFile& logo_file = embedded_file("test_logo.png");
+    auto logo_bytes = embedded_asset(logo_file, asset_buffer);
+    logo_img = LoadImageFromMemory(
+        logo_file.ext, logo_bytes.data(), static_cast<int>(logo_bytes.size())
+    );
     logo = LoadTextureFromImage(logo_img);
 
     //    std::printf("eye: U+%04X\n", codepoint(ICON_FA_EYE));
@@ -344,7 +679,9 @@ int main() {
         EndDrawing();
     }
 
-    encoding::remove_all_temp_files();
+    // joins the install thread, cancelling it if the window was closed
+    // mid install
+    data.install.reset();
     delete g_clayManInstance;
     for (const auto& font : fonts) {
         UnloadFont(font);
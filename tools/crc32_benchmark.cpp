@@ -0,0 +1,105 @@
+// crc32_benchmark, compares crc32_update with miniz's table driven mz_crc32
+//
+// usage: crc32_benchmark [megabytes per run]
+//
+// every buffer size is checked for equal results first, misaligned starts
+// and odd tails included, then both are timed over the same data
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../installation/crc32.hpp"
+
+namespace encoding {
+
+#include <miniz.h>
+
+}
+
+using namespace encoding;
+
+using Clock = std::chrono::steady_clock;
+
+// the crcs of every round are added to `checksum`, which is printed so the
+// loop cannot be optimized away
+template <typename Crc>
+static double gigabytes_per_second(
+    Crc crc,
+    const std::vector<uint8_t>& data,
+    size_t size,
+    size_t total,
+    uint32_t& checksum
+) {
+    size_t rounds = std::max<size_t>(1, total / size);
+    uint32_t sink = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i < rounds; ++i)
+        sink ^= crc(sink, data.data(), size);
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    checksum += sink;
+    return static_cast<double>(rounds * size) / elapsed.count() / 1e9;
+}
+
+int main(int argc, char** argv) {
+    size_t total = 256;
+    if (argc > 1)
+        total = std::strtoull(argv[1], nullptr, 10);
+    total = std::max<size_t>(total, 1) << 20;
+
+    constexpr size_t MAX_SIZE = 16 << 20;
+    std::vector<uint8_t> data(MAX_SIZE + 64);
+    std::mt19937_64 random(0x6b6f6e64);
+    for (auto& byte : data)
+        byte = static_cast<uint8_t>(random());
+
+    auto table = [](uint32_t crc, const uint8_t* data, size_t size) {
+        return static_cast<uint32_t>(mz_crc32(crc, data, size));
+    };
+    auto accelerated = [](uint32_t crc, const uint8_t* data, size_t size) {
+        return crc32_update(crc, data, size);
+    };
+
+    for (size_t size = 0; size < 4096; size += 1 + size / 8) {
+        for (size_t offset = 0; offset < 16; ++offset) {
+            const uint8_t* start = data.data() + offset;
+            if (table(CRC32_INIT, start, size) !=
+                accelerated(CRC32_INIT, start, size)) {
+                std::fprintf(
+                    stderr,
+                    "crc mismatch at size %zu offset %zu\n",
+                    size,
+                    offset
+                );
+                return 1;
+            }
+        }
+    }
+    // split updates have to chain like one big one
+    uint32_t split = crc32_update(CRC32_INIT, data.data(), 1000);
+    split = crc32_update(split, data.data() + 1000, MAX_SIZE - 1000);
+    if (split != table(CRC32_INIT, data.data(), MAX_SIZE)) {
+        std::fprintf(stderr, "crc mismatch over chained updates\n");
+        return 1;
+    }
+
+    std::printf("crc32_update uses %s\n", crc32_implementation());
+    std::printf("%10s %12s %12s %8s\n", "size", "mz_crc32", "crc32", "speedup");
+    uint32_t checksum = 0;
+    for (size_t size : {64, 256, 4096, 65536, 1 << 20, 16 << 20}) {
+        double slow = gigabytes_per_second(table, data, size, total, checksum);
+        double fast =
+            gigabytes_per_second(accelerated, data, size, total, checksum);
+        std::printf(
+            "%10zu %9.2f GB/s %9.2f GB/s %7.1fx\n",
+            size,
+            slow,
+            fast,
+            fast / slow
+        );
+    }
+    std::printf("checksum %08x\n", checksum);
+    return 0;
+}
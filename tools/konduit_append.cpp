@@ -0,0 +1,214 @@
+// konduit_append, appends bundles to a finished installer executable so a
+// new payload only needs this copy instead of recompiling embed.c
+//
+// usage: konduit_append -o <output> <installer>
+//                       --bundle <component>=<bundle> [--digests
+//                       <component>=<digests.sha256>] ...
+//
+// the installer finds the bundles again through the trailer at the end of
+// its own image, see installation/payload.hpp for the layout
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../installation/payload.hpp"
+
+using namespace encoding;
+namespace fs = std::filesystem;
+
+struct AppendInput {
+    std::string component;
+    fs::path bundle;
+    fs::path digests;
+};
+
+struct Options {
+    fs::path installer;
+    fs::path output;
+    std::vector<AppendInput> inputs;
+};
+
+static void usage() {
+    std::fprintf(
+        stderr,
+        "usage: konduit_append -o <output> <installer> "
+        "--bundle <component>=<bundle> "
+        "[--digests <component>=<digests.sha256>] ...\n"
+    );
+}
+
+static std::optional<std::pair<std::string, fs::path>>
+split_assignment(std::string_view arg) {
+    auto split = arg.find('=');
+    if (split == 0 || split == std::string_view::npos ||
+        split + 1 == arg.size()) {
+        return std::nullopt;
+    }
+    return std::pair{
+        std::string(arg.substr(0, split)), fs::path(arg.substr(split + 1))
+    };
+}
+
+static std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    std::map<std::string, fs::path> digests;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-o" && has_value) {
+            options.output = argv[++i];
+        } else if ((arg == "--bundle" || arg == "--digests") && has_value) {
+            auto assignment = split_assignment(argv[++i]);
+            if (!assignment)
+                return std::nullopt;
+            if (arg == "--digests") {
+                digests.insert_or_assign(assignment->first, assignment->second);
+            } else {
+                options.inputs.push_back(
+                    {assignment->first, assignment->second, {}}
+                );
+            }
+        } else if (!arg.starts_with("-") && options.installer.empty()) {
+            options.installer = arg;
+        } else {
+            return std::nullopt;
+        }
+    }
+    if (options.installer.empty() || options.output.empty() ||
+        options.inputs.empty()) {
+        return std::nullopt;
+    }
+    for (auto& input : options.inputs) {
+        if (auto it = digests.find(input.component); it != digests.end())
+            input.digests = it->second;
+    }
+    return options;
+}
+
+// bundles can be several GB, so they are streamed instead of loaded
+static bool copy_file_into(const fs::path& path, std::ofstream& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::fprintf(stderr, "failed to open %s\n", path.string().c_str());
+        return false;
+    }
+    std::vector<char> buffer(1024 * 1024);
+    while (in) {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        out.write(buffer.data(), in.gcount());
+    }
+    if (!in.eof()) {
+        std::fprintf(stderr, "failed to read %s\n", path.string().c_str());
+        return false;
+    }
+    return true;
+}
+
+static void pad_to(std::ofstream& out, uint64_t alignment) {
+    static const char zeros[PAYLOAD_ALIGNMENT] = {};
+    auto at = static_cast<uint64_t>(out.tellp());
+    auto padding = (alignment - at % alignment) % alignment;
+    out.write(zeros, static_cast<std::streamsize>(padding));
+}
+
+static bool write_appended(const Options& options) {
+    auto temp = options.output;
+    temp += ".tmp";
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    std::error_code ec;
+    auto fail = [&] {
+        out.close();
+        fs::remove(temp, ec);
+        return false;
+    };
+    if (!out || !copy_file_into(options.installer, out))
+        return fail();
+
+    pad_to(out, PAYLOAD_ALIGNMENT);
+    PayloadTrailer trailer{};
+    trailer.payload_offset = static_cast<uint64_t>(out.tellp());
+    auto offset = [&] {
+        return static_cast<uint64_t>(out.tellp()) - trailer.payload_offset;
+    };
+
+    std::vector<PayloadRecord> records;
+    std::string names;
+    for (const auto& input : options.inputs) {
+        PayloadRecord record{};
+        pad_to(out, PAYLOAD_ALIGNMENT);
+        record.data_offset = offset();
+        if (!copy_file_into(input.bundle, out))
+            return fail();
+        record.data_size = offset() - record.data_offset;
+
+        if (!input.digests.empty()) {
+            record.digests_offset = offset();
+            if (!copy_file_into(input.digests, out))
+                return fail();
+            record.digests_size = offset() - record.digests_offset;
+        }
+
+        record.component_offset = static_cast<uint32_t>(names.size());
+        record.component_size = static_cast<uint32_t>(input.component.size());
+        names += input.component;
+        auto name = input.bundle.filename().string();
+        record.name_offset = static_cast<uint32_t>(names.size());
+        record.name_size = static_cast<uint32_t>(name.size());
+        names += name;
+        records.push_back(record);
+    }
+
+    pad_to(out, alignof(PayloadRecord));
+    trailer.records_offset = offset();
+    trailer.record_count = static_cast<uint32_t>(records.size());
+    trailer.version = PAYLOAD_VERSION;
+    std::memcpy(trailer.magic, PAYLOAD_MAGIC, sizeof(PAYLOAD_MAGIC));
+    out.write(
+        reinterpret_cast<const char*>(records.data()),
+        static_cast<std::streamsize>(records.size() * sizeof(PayloadRecord))
+    );
+    out.write(names.data(), static_cast<std::streamsize>(names.size()));
+    out.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    auto size = static_cast<uint64_t>(out.tellp());
+    out.close();
+    if (out.fail()) {
+        std::fprintf(stderr, "failed to write %s\n", temp.string().c_str());
+        return fail();
+    }
+
+    // the copy has to stay executable
+    fs::permissions(temp, fs::status(options.installer, ec).permissions(), ec);
+    fs::rename(temp, options.output, ec);
+    if (ec) {
+        std::fprintf(
+            stderr,
+            "failed to replace %s: %s\n",
+            options.output.string().c_str(),
+            ec.message().c_str()
+        );
+        return fail();
+    }
+
+    std::printf(
+        "appended %zu bundles to %s: %llu bytes of payload\n",
+        records.size(),
+        options.output.filename().string().c_str(),
+        static_cast<unsigned long long>(size - trailer.payload_offset)
+    );
+    return true;
+}
+
+int main(int argc, char** argv) {
+    auto options = parse_options(argc, argv);
+    if (!options) {
+        usage();
+        return 1;
+    }
+    return write_appended(*options) ? 0 : 1;
+}
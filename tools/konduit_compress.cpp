@@ -0,0 +1,107 @@
+// konduit_compress, compresses a single file into the payload format of a
+// konduit codec, used to shrink the embedded ui assets at build time
+//
+// usage: konduit_compress [--codec deflate|lz4|zstd] [--level n]
+//                         <input> <output>
+//
+// the output is decoded again with decode_to_memory, the decoded size has to
+// be known from elsewhere
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "../installation/codec.hpp"
+
+using namespace encoding;
+namespace fs = std::filesystem;
+
+static void usage() {
+    std::fprintf(
+        stderr,
+        "usage: konduit_compress [--codec deflate|lz4|zstd] [--level n] "
+        "<input> <output>\n"
+    );
+}
+
+int main(int argc, char** argv) {
+    Codec codec = Codec::LZ4;
+    int level = 9;
+    std::vector<fs::path> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--codec" && has_value) {
+            std::string_view name = argv[++i];
+            codec = Codec::UNKNOWN;
+            for (auto known : {Codec::DEFLATE, Codec::LZ4, Codec::ZSTD}) {
+                if (name == codec_name(known))
+                    codec = known;
+            }
+        } else if (arg == "--level" && has_value) {
+            level = std::atoi(argv[++i]);
+        } else if (!arg.starts_with("-")) {
+            paths.emplace_back(arg);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (paths.size() != 2 || codec == Codec::UNKNOWN) {
+        usage();
+        return 1;
+    }
+    if (!codec_available(codec)) {
+        std::fprintf(
+            stderr,
+            "%s support was not compiled into konduit_compress\n",
+            codec_name(codec)
+        );
+        return 1;
+    }
+
+    std::ifstream in(paths[0], std::ios::binary | std::ios::ate);
+    if (!in) {
+        std::fprintf(stderr, "failed to open %s\n", paths[0].string().c_str());
+        return 1;
+    }
+    std::vector<uint8_t> data(static_cast<size_t>(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    if (!in.read(reinterpret_cast<char*>(data.data()), data.size())) {
+        std::fprintf(stderr, "failed to read %s\n", paths[0].string().c_str());
+        return 1;
+    }
+
+    auto packed = encode(codec, data, level);
+    if (!packed) {
+        std::fprintf(
+            stderr, "failed to compress %s\n", paths[0].string().c_str()
+        );
+        return 1;
+    }
+
+    std::error_code ec;
+    fs::create_directories(paths[1].parent_path(), ec);
+    std::ofstream out(paths[1], std::ios::binary | std::ios::trunc);
+    out.write(
+        reinterpret_cast<const char*>(packed->data()),
+        static_cast<std::streamsize>(packed->size())
+    );
+    out.close();
+    if (out.fail()) {
+        std::fprintf(stderr, "failed to write %s\n", paths[1].string().c_str());
+        return 1;
+    }
+
+    std::printf(
+        "compressed %s with %s: %zu -> %zu bytes\n",
+        paths[0].filename().string().c_str(),
+        codec_name(codec),
+        data.size(),
+        packed->size()
+    );
+    return 0;
+}
@@ -0,0 +1,654 @@
+// konduit_pack, builds konduit packs (.kpak) from a zip archive or a directory
+//
+// usage: konduit_pack [--codec stored|deflate|lz4|zstd] [--level n]
+//                     [--solid <chunk bytes>] [--store <ext,ext,...>]
+//                     [--digests <output.sha256>]
+//                     [-o <output.kpak>] <input.zip | input directory>
+//
+// --solid packs files smaller than a quarter of the chunk size into solid
+// chunks of about that size, compressed as one payload each
+//
+// --store lists extensions of already compressed files (png, ttf, archives),
+// these are stored as is and never made solid, so the installer can hand
+// them out straight from the bundle without decoding or copying them
+//
+// files with identical contents are always stored once
+//
+// --digests writes the sha256 tree digest of every file, which the installer
+// embeds and verifies the installed files against, on its own it only writes
+// the digests so plain zip bundles get them too
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+#include "../installation/codec.hpp"
+#include "../installation/crc32.hpp"
+#include "../installation/digests.hpp"
+#include "../installation/kpack.hpp"
+
+namespace encoding {
+
+#include <miniz.h>
+
+}
+
+using namespace encoding;
+namespace fs = std::filesystem;
+
+struct Options {
+    Codec codec = Codec::LZ4;
+    int level = 9;
+    /// target solid chunk size, 0 compresses every file on its own
+    uint64_t solid_size = 0;
+    /// lowercase extensions without the dot, stored uncompressed
+    std::vector<std::string> store_extensions;
+    fs::path input;
+    fs::path output;
+    fs::path digests;
+};
+
+struct PackInput {
+    std::string name;
+    bool directory;
+    uint64_t size;
+    uint32_t mode;
+    int64_t mtime;
+    std::function<std::optional<std::vector<uint8_t>>()> load;
+};
+
+static void usage() {
+    std::fprintf(
+        stderr,
+        "usage: konduit_pack [--codec stored|deflate|lz4|zstd] [--level n] "
+        "[--solid <chunk bytes>] [--store <ext,ext,...>] "
+        "[--digests <output.sha256>] "
+        "[-o <output.kpak>] <input.zip | input directory>\n"
+    );
+}
+
+static std::optional<Codec> parse_codec(std::string_view name) {
+    for (auto codec :
+         {Codec::STORED, Codec::DEFLATE, Codec::LZ4, Codec::ZSTD}) {
+        if (name == codec_name(codec))
+            return codec;
+    }
+    return std::nullopt;
+}
+
+static std::string lowercase(std::string text) {
+    std::ranges::transform(text, text.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return text;
+}
+
+static std::vector<std::string> parse_extensions(std::string_view list) {
+    std::vector<std::string> extensions;
+    while (!list.empty()) {
+        auto end = list.find(',');
+        auto extension = list.substr(0, end);
+        list = end == std::string_view::npos ? std::string_view{}
+                                             : list.substr(end + 1);
+        if (extension.starts_with('.'))
+            extension.remove_prefix(1);
+        if (extension.empty())
+            continue;
+        extensions.push_back(lowercase(std::string(extension)));
+    }
+    return extensions;
+}
+
+static std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--codec" && has_value) {
+            auto codec = parse_codec(argv[++i]);
+            if (!codec) {
+                std::fprintf(stderr, "unknown codec %s\n", argv[i]);
+                return std::nullopt;
+            }
+            options.codec = *codec;
+        } else if (arg == "--level" && has_value) {
+            options.level = std::atoi(argv[++i]);
+        } else if (arg == "--solid" && has_value) {
+            options.solid_size = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--store" && has_value) {
+            options.store_extensions = parse_extensions(argv[++i]);
+        } else if (arg == "--digests" && has_value) {
+            options.digests = argv[++i];
+        } else if (arg == "-o" && has_value) {
+            options.output = argv[++i];
+        } else if (!arg.starts_with("-") && options.input.empty()) {
+            options.input = arg;
+        } else {
+            return std::nullopt;
+        }
+    }
+    if (options.input.empty() ||
+        (options.output.empty() && options.digests.empty())) {
+        return std::nullopt;
+    }
+    if (!codec_available(options.codec)) {
+        std::fprintf(
+            stderr,
+            "%s support was not compiled into konduit_pack\n",
+            codec_name(options.codec)
+        );
+        return std::nullopt;
+    }
+    return options;
+}
+
+static std::optional<std::vector<uint8_t>> read_file(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return std::nullopt;
+    std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0, std::ios::beg);
+    if (!file.read(reinterpret_cast<char*>(data.data()), data.size()))
+        return std::nullopt;
+    return data;
+}
+
+static std::optional<std::vector<PackInput>> collect_zip(mz_zip_archive& zip) {
+    constexpr int MADE_BY_UNIX = 3;
+
+    std::vector<PackInput> inputs;
+    uint32_t count = mz_zip_reader_get_num_files(&zip);
+    for (uint32_t i = 0; i < count; ++i) {
+        mz_zip_archive_file_stat stat;
+        if (!mz_zip_reader_file_stat(&zip, i, &stat))
+            return std::nullopt;
+
+        bool directory = stat.m_is_directory;
+        uint32_t mode = directory ? 0755 : 0644;
+        if ((stat.m_version_made_by >> 8) == MADE_BY_UNIX &&
+            (stat.m_external_attr >> 16) != 0) {
+            mode = (stat.m_external_attr >> 16) & 07777;
+        }
+
+        inputs.push_back({
+            .name = stat.m_filename,
+            .directory = directory,
+            .size = stat.m_uncomp_size,
+            .mode = mode,
+            .mtime = static_cast<int64_t>(stat.m_time),
+            .load = [&zip, i]() -> std::optional<std::vector<uint8_t>> {
+                size_t size = 0;
+                void* data = mz_zip_reader_extract_to_heap(&zip, i, &size, 0);
+                if (!data)
+                    return std::nullopt;
+                std::vector<uint8_t> result(
+                    static_cast<uint8_t*>(data),
+                    static_cast<uint8_t*>(data) + size
+                );
+                mz_free(data);
+                return result;
+            },
+        });
+    }
+    return inputs;
+}
+
+static std::optional<std::vector<PackInput>>
+collect_directory(const fs::path& root) {
+    std::vector<PackInput> inputs;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(root, ec);
+         !ec && it != fs::recursive_directory_iterator();
+         it.increment(ec)) {
+        const auto& path = it->path();
+        bool directory = it->is_directory(ec);
+        if (!directory && !it->is_regular_file(ec))
+            continue;
+
+        auto name = path.lexically_relative(root).generic_string();
+        if (directory)
+            name += '/';
+
+        auto mtime = std::chrono::file_clock::to_sys(it->last_write_time(ec));
+        inputs.push_back({
+            .name = std::move(name),
+            .directory = directory,
+            .size = directory ? 0 : it->file_size(ec),
+            .mode = static_cast<uint32_t>(it->status(ec).permissions()) &
+                    07777,
+            .mtime = std::chrono::duration_cast<std::chrono::seconds>(
+                         mtime.time_since_epoch()
+            )
+                         .count(),
+            .load = [path] { return read_file(path); },
+        });
+    }
+    if (ec) {
+        std::fprintf(
+            stderr,
+            "failed to walk %s: %s\n",
+            root.string().c_str(),
+            ec.message().c_str()
+        );
+        return std::nullopt;
+    }
+
+    // directory iteration order is unspecified, sorting keeps packs
+    // reproducible
+    std::sort(
+        inputs.begin(),
+        inputs.end(),
+        [](const PackInput& a, const PackInput& b) { return a.name < b.name; }
+    );
+    return inputs;
+}
+
+// later copies of a name would be unreachable through the slot table, the
+// first one is kept for the pack and its digest alike
+static void drop_duplicate_names(std::vector<PackInput>& inputs) {
+    std::unordered_set<std::string> seen;
+    std::erase_if(inputs, [&](const PackInput& input) {
+        if (seen.insert(input.name).second)
+            return false;
+        std::fprintf(stderr, "skipping duplicate %s\n", input.name.c_str());
+        return true;
+    });
+}
+
+static bool
+write_digests(const std::vector<PackInput>& inputs, const fs::path& path) {
+    DigestManifest digests;
+    for (const auto& input : inputs) {
+        if (input.directory)
+            continue;
+        auto data = input.load();
+        if (!data) {
+            std::fprintf(stderr, "failed to read %s\n", input.name.c_str());
+            return false;
+        }
+        digests.try_emplace(
+            input.name,
+            DigestEntry{data->size(), digest_tree(data->data(), data->size())}
+        );
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << format_digests(digests);
+    file.close();
+    if (file.fail()) {
+        std::fprintf(stderr, "failed to write %s\n", path.string().c_str());
+        return false;
+    }
+    std::printf(
+        "wrote sha256 digests of %zu files to %s\n",
+        digests.size(),
+        path.string().c_str()
+    );
+    return true;
+}
+
+// compressing these again gains next to nothing and costs a decode at
+// install time
+static bool store_as_is(const PackInput& input, const Options& options) {
+    auto extension = lowercase(fs::path(input.name).extension().string());
+    if (extension.empty())
+        return false;
+    return std::ranges::find(
+               options.store_extensions, std::string_view(extension).substr(1)
+           ) != options.store_extensions.end();
+}
+
+static bool write_pack(std::vector<PackInput>& inputs, const Options& options) {
+    auto count = static_cast<uint32_t>(inputs.size());
+    uint32_t slot_count = 16;
+    while (slot_count < static_cast<uint64_t>(count) * 2) {
+        slot_count <<= 1;
+    }
+
+    std::vector<PackEntry> entries(count);
+    std::vector<PackSlot> slots(slot_count);
+    std::string names;
+    for (uint32_t i = 0; i < count; ++i) {
+        entries[i].name_offset = static_cast<uint32_t>(names.size());
+        entries[i].name_size = static_cast<uint32_t>(inputs[i].name.size());
+        names += inputs[i].name;
+
+        uint64_t hash = pack_hash(inputs[i].name);
+        uint32_t slot = static_cast<uint32_t>(hash) & (slot_count - 1);
+        while (slots[slot].entry != 0) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = {i + 1, static_cast<uint32_t>(hash)};
+    }
+
+    auto describe = [](PackEntry& entry,
+                       const PackInput& input,
+                       std::span<const uint8_t> data) {
+        entry.mode = input.mode;
+        entry.mtime = input.mtime;
+        entry.uncompressed_size = data.size();
+        entry.crc32 = crc32_update(CRC32_INIT, data.data(), data.size());
+        entry.content_hash = pack_hash(data.data(), data.size());
+    };
+
+    // files with the same contents are stored once, every later copy points
+    // at the payload of the first, this costs a second read of every input,
+    // and a third of the files that turn out to be copies, but keeps the
+    // builder from holding the whole bundle in memory
+    constexpr uint32_t UNIQUE = UINT32_MAX;
+    std::vector<uint32_t> duplicate_of(count, UNIQUE);
+    uint32_t duplicates = 0;
+    uint64_t duplicate_bytes = 0;
+    {
+        std::map<std::tuple<uint64_t, uint32_t, uint64_t>, uint32_t> blobs;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (inputs[i].directory)
+                continue;
+            auto data = inputs[i].load();
+            if (!data) {
+                std::fprintf(
+                    stderr, "failed to read %s\n", inputs[i].name.c_str()
+                );
+                return false;
+            }
+            describe(entries[i], inputs[i], *data);
+            inputs[i].size = data->size();
+            if (data->empty())
+                continue;
+
+            auto [it, inserted] = blobs.try_emplace(
+                {entries[i].uncompressed_size,
+                 entries[i].crc32,
+                 entries[i].content_hash},
+                i
+            );
+            if (inserted)
+                continue;
+            // the key is no digest, a match is only taken once the bytes
+            // agree, a colliding file is simply stored on its own
+            auto source = inputs[it->second].load();
+            if (!source) {
+                std::fprintf(
+                    stderr,
+                    "failed to read %s\n",
+                    inputs[it->second].name.c_str()
+                );
+                return false;
+            }
+            if (!std::ranges::equal(*data, *source))
+                continue;
+            duplicate_of[i] = it->second;
+            duplicates++;
+            duplicate_bytes += data->size();
+        }
+    }
+
+    // small files are grouped into solid chunks in input order, which keeps
+    // files from the same directory together
+    std::vector<std::vector<uint32_t>> chunks;
+    if (options.solid_size != 0) {
+        uint64_t chunk_used = options.solid_size;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (inputs[i].directory || inputs[i].size == 0 ||
+                inputs[i].size >= options.solid_size / 4 ||
+                duplicate_of[i] != UNIQUE || store_as_is(inputs[i], options)) {
+                continue;
+            }
+            if (chunk_used >= options.solid_size) {
+                chunks.emplace_back();
+                chunk_used = 0;
+            }
+            chunks.back().push_back(i);
+            chunk_used += inputs[i].size;
+        }
+    }
+    auto chunk_count = static_cast<uint32_t>(chunks.size());
+    std::vector<PackChunk> chunk_table(chunk_count);
+
+    PackHeader header{};
+    std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = PACK_VERSION;
+    header.header_size = sizeof(PackHeader);
+    header.entry_count = count;
+    header.entry_size = sizeof(PackEntry);
+    header.slot_count = slot_count;
+    header.chunk_count = chunk_count;
+    header.chunk_size = sizeof(PackChunk);
+    header.entries_offset = sizeof(PackHeader);
+    header.chunks_offset =
+        header.entries_offset + uint64_t{count} * sizeof(PackEntry);
+    header.slots_offset =
+        header.chunks_offset + uint64_t{chunk_count} * sizeof(PackChunk);
+    header.names_offset =
+        header.slots_offset + uint64_t{slot_count} * sizeof(PackSlot);
+    header.names_size = names.size();
+
+    std::ofstream out(options.output, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::fprintf(
+            stderr, "failed to open %s\n", options.output.string().c_str()
+        );
+        return false;
+    }
+
+    // payloads go after the tables, which are written last once every
+    // offset is known
+    uint64_t offset =
+        pack_align(header.names_offset + header.names_size, PACK_ALIGNMENT);
+    out.seekp(static_cast<std::streamoff>(offset));
+
+    uint64_t total_in = 0;
+    uint64_t total_out = 0;
+
+    // compresses and appends one payload, payloads that do not shrink are
+    // stored since decoding them is free
+    auto write_payload = [&](std::span<const uint8_t> data,
+                             bool compress,
+                             Codec& codec) -> std::optional<uint64_t> {
+        static constexpr char padding[PACK_ALIGNMENT] = {};
+
+        std::optional<std::vector<uint8_t>> packed;
+        if (compress && options.codec != Codec::STORED) {
+            packed = encode(options.codec, data, options.level);
+            if (!packed)
+                return std::nullopt;
+        }
+
+        bool keep = packed && packed->size() < data.size();
+        auto payload = keep ? std::span<const uint8_t>(*packed) : data;
+        codec = keep ? options.codec : Codec::STORED;
+
+        out.write(
+            reinterpret_cast<const char*>(payload.data()),
+            static_cast<std::streamsize>(payload.size())
+        );
+        offset += payload.size();
+        uint64_t aligned = pack_align(offset, PACK_DATA_ALIGNMENT);
+        out.write(padding, static_cast<std::streamsize>(aligned - offset));
+        offset = aligned;
+
+        total_in += data.size();
+        total_out += payload.size();
+        return payload.size();
+    };
+
+    std::vector<bool> solid(count);
+    for (const auto& members : chunks) {
+        for (auto i : members) {
+            solid[i] = true;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        auto& entry = entries[i];
+        const auto& input = inputs[i];
+        if (solid[i] || duplicate_of[i] != UNIQUE)
+            continue;
+
+        entry.data_offset = offset;
+        if (input.directory) {
+            entry.mode = input.mode;
+            entry.mtime = input.mtime;
+            entry.flags |= PACK_ENTRY_DIRECTORY;
+            continue;
+        }
+
+        auto data = input.load();
+        if (!data) {
+            std::fprintf(stderr, "failed to read %s\n", input.name.c_str());
+            return false;
+        }
+
+        describe(entry, input, *data);
+        Codec codec;
+        auto written =
+            write_payload(*data, !store_as_is(input, options), codec);
+        if (!written) {
+            std::fprintf(
+                stderr, "failed to compress %s\n", input.name.c_str()
+            );
+            return false;
+        }
+        entry.codec = static_cast<uint8_t>(codec);
+        entry.compressed_size = *written;
+    }
+
+    std::vector<uint8_t> chunk_data;
+    for (uint32_t c = 0; c < chunk_count; ++c) {
+        chunk_data.clear();
+        for (auto i : chunks[c]) {
+            auto data = inputs[i].load();
+            if (!data) {
+                std::fprintf(
+                    stderr, "failed to read %s\n", inputs[i].name.c_str()
+                );
+                return false;
+            }
+
+            auto& entry = entries[i];
+            describe(entry, inputs[i], *data);
+            entry.flags |= PACK_ENTRY_SOLID;
+            entry.chunk = c;
+            entry.data_offset = chunk_data.size();
+            chunk_data.insert(chunk_data.end(), data->begin(), data->end());
+        }
+
+        auto& chunk = chunk_table[c];
+        chunk.data_offset = offset;
+        chunk.uncompressed_size = chunk_data.size();
+        Codec codec;
+        auto written = write_payload(chunk_data, true, codec);
+        if (!written) {
+            std::fprintf(stderr, "failed to compress chunk %u\n", c);
+            return false;
+        }
+        chunk.codec = static_cast<uint8_t>(codec);
+        chunk.compressed_size = *written;
+        for (auto i : chunks[c]) {
+            entries[i].codec = chunk.codec;
+        }
+    }
+
+    // a duplicate keeps its own name, mode and mtime and shares the rest
+    for (uint32_t i = 0; i < count; ++i) {
+        if (duplicate_of[i] == UNIQUE)
+            continue;
+        const auto& original = entries[duplicate_of[i]];
+        auto& entry = entries[i];
+        entry.data_offset = original.data_offset;
+        entry.compressed_size = original.compressed_size;
+        entry.codec = original.codec;
+        entry.flags |= original.flags & PACK_ENTRY_SOLID;
+        entry.chunk = original.chunk;
+    }
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(
+        reinterpret_cast<const char*>(entries.data()),
+        static_cast<std::streamsize>(entries.size() * sizeof(PackEntry))
+    );
+    out.write(
+        reinterpret_cast<const char*>(chunk_table.data()),
+        static_cast<std::streamsize>(chunk_table.size() * sizeof(PackChunk))
+    );
+    out.write(
+        reinterpret_cast<const char*>(slots.data()),
+        static_cast<std::streamsize>(slots.size() * sizeof(PackSlot))
+    );
+    out.write(names.data(), static_cast<std::streamsize>(names.size()));
+    out.close();
+
+    if (out.fail()) {
+        std::fprintf(
+            stderr, "failed to write %s\n", options.output.string().c_str()
+        );
+        return false;
+    }
+
+    std::printf(
+        "packed %u entries (%u solid chunks, %u duplicates of %llu bytes) "
+        "with %s: %llu -> %llu bytes\n",
+        count,
+        chunk_count,
+        duplicates,
+        static_cast<unsigned long long>(duplicate_bytes),
+        codec_name(options.codec),
+        static_cast<unsigned long long>(total_in),
+        static_cast<unsigned long long>(total_out)
+    );
+    return true;
+}
+
+// the digests are hashed from the inputs, not the pack, so they describe what
+// the installer has to write no matter how it was packed
+static bool
+write_outputs(std::vector<PackInput>& inputs, const Options& options) {
+    drop_duplicate_names(inputs);
+    if (!options.digests.empty() && !write_digests(inputs, options.digests))
+        return false;
+    return options.output.empty() || write_pack(inputs, options);
+}
+
+int main(int argc, char** argv) {
+    auto options = parse_options(argc, argv);
+    if (!options) {
+        usage();
+        return 1;
+    }
+
+    std::error_code ec;
+    if (fs::is_directory(options->input, ec)) {
+        auto inputs = collect_directory(options->input);
+        return inputs && write_outputs(*inputs, *options) ? 0 : 1;
+    }
+
+    mz_zip_archive zip;
+    mz_zip_zero_struct(&zip);
+    if (!mz_zip_reader_init_file(&zip, options->input.string().c_str(), 0)) {
+        std::fprintf(
+            stderr,
+            "%s is neither a directory nor a zip archive\n",
+            options->input.string().c_str()
+        );
+        return 1;
+    }
+
+    auto inputs = collect_zip(zip);
+    bool ok = inputs && write_outputs(*inputs, *options);
+    mz_zip_reader_end(&zip);
+    return ok ? 0 : 1;
+}
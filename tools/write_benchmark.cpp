@@ -0,0 +1,155 @@
+// write_benchmark, extracts a bundle once per write backend and compares how
+// long the writers took to put it on disk
+//
+// usage: write_benchmark [bundle] [scratch directory] [runs] [--sync]
+//
+// defaults to the test bundle the installer is built with, every run goes
+// into a fresh directory below a new one the tool creates in the scratch
+// directory, only that one is removed afterwards. the best of the runs
+// counts, the first run of all also pages the bundle in
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include "../installation/install_pipeline.hpp"
+
+using namespace encoding;
+namespace fs = std::filesystem;
+
+struct BenchmarkRun {
+    double wall = 0;
+    double write_busy = 0;
+    uint32_t files = 0;
+    uint64_t bytes = 0;
+};
+
+static std::optional<BenchmarkRun> extract_once(
+    ZipReader* reader,
+    const fs::path& path,
+    WriteBackend backend,
+    bool sync
+) {
+    std::error_code ec;
+    fs::remove_all(path, ec);
+    PipelineOptions options;
+    options.write_backend = backend;
+    options.sync_files = sync;
+    auto result = install_pipelined(reader, path, options);
+    fs::remove_all(path, ec);
+    if (!result || !result->extract.failed.empty()) {
+        std::fprintf(
+            stderr,
+            "extraction with %s failed\n",
+            write_backend_name(backend)
+        );
+        return std::nullopt;
+    }
+    return BenchmarkRun{
+        result->wall_seconds,
+        result->write.busy_seconds,
+        result->extract.files_written,
+        result->extract.bytes_written,
+    };
+}
+
+// a directory below `scratch` that did not exist before, so removing it never
+// takes anything of the user's along
+static std::optional<fs::path> create_work_directory(const fs::path& scratch) {
+    std::error_code ec;
+    fs::create_directories(scratch, ec);
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        auto path = scratch / ("write_benchmark-" + std::to_string(attempt));
+        if (fs::create_directory(path, ec))
+            return path;
+        if (ec)
+            break;
+    }
+    std::fprintf(
+        stderr,
+        "failed to create a directory in %s: %s\n",
+        scratch.string().c_str(),
+        ec ? ec.message().c_str() : "every name is taken"
+    );
+    return std::nullopt;
+}
+
+// extracts the bundle `runs` times with every available backend into
+// `work` and prints the best run of each
+static bool
+compare_backends(ZipReader* reader, const fs::path& work, int runs, bool sync) {
+    std::optional<BenchmarkRun> reference;
+    for (auto backend : {WriteBackend::THREADS, WriteBackend::IO_URING}) {
+        const char* name = write_backend_name(backend);
+        if (!write_backend_available(backend)) {
+            std::printf("%-8s unavailable\n", name);
+            continue;
+        }
+
+        std::optional<BenchmarkRun> best;
+        for (int run = 0; run < runs; ++run) {
+            auto result = extract_once(reader, work / name, backend, sync);
+            if (!result)
+                return false;
+            if (!best || result->wall < best->wall)
+                best = result;
+        }
+        // both backends have to leave the same tree behind
+        if (reference && (reference->files != best->files ||
+                          reference->bytes != best->bytes)) {
+            std::fprintf(stderr, "%s wrote a different tree\n", name);
+            return false;
+        }
+        reference = best;
+
+        std::printf(
+            "%-8s %u files, %.1f MiB in %.3fs, writers busy %.3fs, "
+            "%.1f MiB/s\n",
+            name,
+            best->files,
+            static_cast<double>(best->bytes) / (1024 * 1024),
+            best->wall,
+            best->write_busy,
+            static_cast<double>(best->bytes) / best->wall / (1024 * 1024)
+        );
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> positional;
+    bool sync = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sync") {
+            sync = true;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    std::string bundle =
+        positional.size() > 0 ? positional[0] : KONDUIT_TEST_BUNDLE;
+    fs::path scratch = positional.size() > 1
+                           ? fs::path(positional[1])
+                           : fs::temp_directory_path();
+    int runs = positional.size() > 2 ? std::atoi(positional[2].c_str()) : 3;
+    runs = std::max(runs, 1);
+
+    SetTraceLogLevel(LOG_WARNING);
+    auto reader = zip_init_from_file(bundle);
+    if (!reader) {
+        std::fprintf(stderr, "failed to open %s\n", bundle.c_str());
+        return 1;
+    }
+    auto work = create_work_directory(scratch);
+    if (!work)
+        return 1;
+
+    bool ok = compare_backends(reader.get(), *work, runs, sync);
+    std::error_code ec;
+    fs::remove_all(*work, ec);
+    return ok ? 0 : 1;
+}
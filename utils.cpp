@@ -1,6 +1,8 @@
 #include "utils.hpp"
 
 #include <utility>
+#include "installation/manifest.hpp"
+#include "installation/transaction.hpp"
 
 Clay_Sizing center_percent() {
     return Clay_Sizing{
@@ -79,7 +81,8 @@ bool is_directory_empty(const std::filesystem::path& p, std::error_code& ec) {
     return begin == std::filesystem::directory_iterator{};
 }
 
-DirectoryValidationResult validate_path(const std::string& path_str) {
+DirectoryValidationResult
+validate_path(const std::string& path_str, uint64_t required_bytes) {
     DirectoryValidationResult result;
 
     if (path_str.empty() ||
@@ -131,10 +134,18 @@ DirectoryValidationResult validate_path(const std::string& path_str) {
             result.empty_initially = is_empty;
             if (is_empty) {
                 result.usable = true;
+            } else if (encoding::has_manifest(p)) {
+                result.usable = true;
+                result.existing_install = true;
+            } else if (encoding::has_interrupted_install(p)) {
+                // a first install a crash interrupted, it is rolled back
+                // before the next one starts
+                result.usable = true;
             } else {
                 result.usable = false;
                 result.error_message =
-                    "directory exists but is not empty. cannot proceed.";
+                    "directory exists, is not empty and holds no previous "
+                    "installation. cannot proceed.";
             }
         } else {
             result.error_message =
@@ -148,6 +159,29 @@ DirectoryValidationResult validate_path(const std::string& path_str) {
         result.usable = true;
     }
 
+    // an install that cannot fit fails here instead of once the disk runs
+    // full minutes into writing
+    if (result.usable && required_bytes > 0) {
+        // a directory that does not exist yet ends up on the volume of its
+        // closest existing parent
+        auto existing = p;
+        while (!std::filesystem::exists(existing, ec) &&
+               existing != existing.parent_path()) {
+            existing = existing.parent_path();
+        }
+        auto space = std::filesystem::space(existing, ec);
+        if (!ec && space.available < required_bytes) {
+            constexpr double MIB = 1024 * 1024;
+            result.usable = false;
+            result.enough_space = false;
+            result.error_message = std::format(
+                "{:.1f} MiB are needed but only {:.1f} MiB are free.",
+                static_cast<double>(required_bytes) / MIB,
+                static_cast<double>(space.available) / MIB
+            );
+        }
+    }
+
     return result;
 }
 
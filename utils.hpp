@@ -51,12 +51,19 @@ struct DirectoryValidationResult {
     bool exists_and_is_dir = false;
     bool empty_initially = false;
     bool usable = true;
+    /// the directory holds a previous install that can be updated in place
+    bool existing_install = false;
+    /// false when its volume has less free space than the install needs
+    bool enough_space = true;
     std::string error_message;
 };
 
 bool is_directory_empty(const std::filesystem::path& p, std::error_code& ec);
 
-DirectoryValidationResult validate_path(const std::string& path_str);
+/// `required_bytes` is what the install is going to write, a path without
+/// that much free space is not usable
+DirectoryValidationResult
+validate_path(const std::string& path_str, uint64_t required_bytes = 0);
 
 static inline Color to_raylib_color(const Clay_Color& clayColor) {
     return {